@@ -5,97 +5,171 @@
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <mutex>
 #include <string>
 
 #include "Vtop.h"
+#if VM_COVERAGE
+#include "Vtop__Syms.h"
+#include "Vtop___024root.h"
+#endif
+#include "campaign_daemon.h"
+#include "campaign_statistics.h"
+#include "checkpoint_ladder.h"
+#include "coverage_scheduler.h"
 #include "data_monitor.h"
+#include "fault_dictionary.h"
 #include "fault_injection.h"
+#include "parallel_tuner.h"
 
+// Threads the model was verilated with, set by the `sim_threads` target
+#ifndef FULL_MODEL_THREADS
+#define FULL_MODEL_THREADS 1
+#endif
+
+// Context of a model, the threads must be set before the model is built
+VerilatedContext *NewContext(bool trace, unsigned int model_threads) {
+  VerilatedContext *cp = new VerilatedContext;
+#if defined(VERILATOR_VERSION_INTEGER) && VERILATOR_VERSION_INTEGER >= 5000000
+  // Older versions only use the threads given when verilating
+  if (model_threads) {
+    cp->threads(model_threads);
+  }
+#else
+  (void)model_threads;
+#endif
+  cp->traceEverOn(trace);
+  return cp;
+}
+
+// Model of the design, built once and reused for all runs
 class FullInvestigation {
  public:
-  FullInvestigation(FaultInjection *fi) : fi_(fi){};
+  // Build the model and add its abort watch and value comparators to `fi`. A
+  // trace is only written if `trace` is set, `model_threads` of 0 keeps the
+  // number of threads the model was verilated with.
+  FullInvestigation(FaultInjection *fi, bool trace = true,
+                    unsigned int model_threads = 0);
+  ~FullInvestigation();
+  // Simulate the fault configured in `fi`, starting from the reset
   void Run();
+  // Collect the behaviour of each run in `coverage`
+  void SetCoverage(CoverageMap *coverage) { coverage_ = coverage; }
 
  private:
   FaultInjection *fi_;
+  std::unique_ptr<VerilatedContext> cp_;
+  std::unique_ptr<Vtop> top_;
+  std::unique_ptr<VerilatedVcdC> tfp_;
+  // Runs are written one after the other to the trace
+  uint64_t trace_offset_ = 0;
+  // Values to compare against
+  CData data_[3] = {0xac, 0x57, 0x86};
+  IData secret_[1] = {0xdeadbeef};
+  DataMonitor<CData> data_o_;
+  DataMonitor<IData> secret_o_;
+  // Snapshot of the model before the first cycle
+  CheckpointLadder<Vtop> reset_;
+  CoverageMap *coverage_ = nullptr;
 };
 
-void FullInvestigation::Run() {
-  const std::unique_ptr<VerilatedContext> cp{new VerilatedContext};
-
-  cp->traceEverOn(true);
-
-  const std::unique_ptr<Vtop> top{new Vtop{cp.get(), "TOP"}};
-
-  top->clk = 0;
-  top->rst = 1;
-
-  VerilatedVcdC *tfp = new VerilatedVcdC;
-  top->trace(tfp, 99);
-  tfp->open("trace.vcd");
-
-  fi_->SetFaultDuration(2);
+FullInvestigation::FullInvestigation(FaultInjection *fi, bool trace,
+                                     unsigned int model_threads)
+    : fi_(fi),
+      cp_(NewContext(trace, model_threads)),
+      top_(new Vtop{cp_.get(), "TOP"}),
+      data_o_("data_o", &top_->data_o, data_, sizeof(data_) / sizeof(CData)),
+      secret_o_("secret_o", &top_->secret_o, secret_,
+                sizeof(secret_) / sizeof(IData)),
+      reset_(top_.get(), cp_.get(), 1) {
+  if (trace) {
+    tfp_.reset(new VerilatedVcdC);
+    top_->trace(tfp_.get(), 99);
+    tfp_->open("trace.vcd");
+  }
 
   // Create a check for `alert_o` and delay the stop for 10 cycles
-  fi_->AddAbortWatch("alert_o", &top->alert_o, 10);
+  fi_->AddAbortWatch("alert_o", &top_->alert_o, 10);
 
   // Check for 8-bit signal
-  // Define values to compare against
-  CData data[] = {0xac, 0x57, 0x86};
-  // Create object connected to a design signal and the comparison values
-  DataMonitor<CData> data_o("data_o", &top->data_o, data,
-                            sizeof(data) / sizeof(CData));
   // Create a bind function
-  std::function<bool(std::string &)> data_o_compare =
-      std::bind(&DataMonitor<CData>::Compare, &data_o, std::placeholders::_1);
+  std::function<bool(uint64_t &)> data_o_compare =
+      std::bind(&DataMonitor<CData>::Match, &data_o_, std::placeholders::_1);
   // Add the function to the watch list
-  fi_->AddValueComparator(data_o_compare);
+  fi_->AddValueComparator(data_o_.Name(), data_o_compare);
 
   // Check for 32-bit signal
-  IData secret[] = {0xdeadbeef};
-  DataMonitor<IData> secret_o("secret_o", &top->secret_o, secret,
-                              sizeof(secret) / sizeof(IData));
-  std::function<bool(std::string &)> secret_o_compare =
-      std::bind(&DataMonitor<IData>::Compare, &secret_o, std::placeholders::_1);
-  fi_->AddValueComparator(secret_o_compare);
-
-  struct Fault f = fi_->GetFaultSpace();
-  std::cout << "Starting simulation with fault injection config: " << f
-            << std::endl;
-
-  while (cp->time() < 200) {
+  std::function<bool(uint64_t &)> secret_o_compare = std::bind(
+      &DataMonitor<IData>::Match, &secret_o_, std::placeholders::_1);
+  fi_->AddValueComparator(secret_o_.Name(), secret_o_compare);
+
+  // Keep the state before the first cycle, each run starts from there
+  top_->clk = 0;
+  top_->rst = 1;
+  top_->start_i = 0;
+  top_->eval();
+  reset_.Capture(0);
+}
+
+FullInvestigation::~FullInvestigation() {
+  top_->final();
+  if (tfp_) {
+    tfp_->close();
+  }
+}
+
+void FullInvestigation::Run() {
+  // Continue the cycle count of `fi` from the snapshot
+  reset_.Restore(*fi_);
+#if VM_COVERAGE
+  // Only count the coverage points of this run
+  if (coverage_) {
+    cp_->coveragep()->zero();
+  }
+#endif
+
+  while (cp_->time() < 200) {
     // Alternate clock
-    cp->timeInc(1);
-    top->clk = !top->clk;
+    cp_->timeInc(1);
+    top_->clk = !top_->clk;
 
-    if (!top->clk) {
-      if (cp->time() > 2) {
-        top->rst = 0;
-        top->start_i = true;
+    if (!top_->clk) {
+      if (cp_->time() > 2) {
+        top_->rst = 0;
+        top_->start_i = true;
       }
     }
 
-    if (top->clk) {
-      fi_->UpdateInsert(top->fi_combined);
+    if (top_->clk) {
+      fi_->UpdateInsert(top_->fi_combined);
     }
 
-    top->eval();
+    top_->eval();
+
+    // State of the FSM as seen at the outputs: done_o in TWO, data_o in FINAL,
+    // alert_o in ERROR and secret_o in HIDDEN
+    if (top_->clk && coverage_) {
+      coverage_->Observe(top_->done_o | top_->alert_o << 1 |
+                         (top_->secret_o != 0) << 2 | top_->data_o << 3);
+    }
 
     // Check for a stop request
-    if (top->clk) {
+    if (top_->clk) {
       if (fi_->StopRequested()) {
         break;
       }
     }
 
-    tfp->dump(cp->time());
+    if (tfp_) {
+      tfp_->dump(trace_offset_ + cp_->time());
+    }
   }
-
-  std::cout << *fi_ << std::endl;
-
-  // Finish
-  top->final();
-  tfp->close();
+  trace_offset_ += cp_->time();
+#if VM_COVERAGE
+  if (coverage_) {
+    coverage_->ObserveCounters(top_->rootp->vlSymsp->__Vcoverage);
+  }
+#endif
 }
 
 int main(int argc, char *argv[], char **env) {
@@ -107,20 +181,132 @@ int main(int argc, char *argv[], char **env) {
   // Create a fault injection instance by providing the length of the fault
   // injection bus. All other settings are provided by command line arguments.
   FaultInjection fi(fi_combined_len);
-  bool exit_app;
+  bool exit_app = false;
   fi.ParseCommandArgs(argc, argv, exit_app);
   if (exit_app) {
     return -1;
   }
 
-  for (int i = 0; i < fi.IterationLength(); ++i) {
-    fi.UpdateSpace(i);
+  // Default for all runs, the daemon can change it with `duration`
+  fi.SetFaultDuration(2);
+
+  // Aggregate the outcome of all runs per bit, per 10 cycles and per fault
+  // signal group of the top-level module (see `figenerator` in `top_fi.v`).
+  CampaignStatistics stats(fi_combined_len, 0, 10, 20);
+  stats.AddModule("top_ff", 0, 7);
+  stats.AddModule("top_comb", 7, 92);
+  stats.SetCheckpoint("fi_stats", 1000);
+
+  // Keep running and simulate the faults requested on the socket, failures
+  // are looked up in the dictionary of earlier campaigns
+  if (!fi.DaemonSocket().empty()) {
+    FullInvestigation full(&fi, false);
+    CampaignDaemon daemon(fi, [&full, &stats](FaultInjection &f) {
+      full.Run();
+      stats.Record(f);
+    });
+    FaultDictionary dict;
+    if (dict.Open("fi_faults.dict")) {
+      daemon.SetDictionary(&dict);
+    }
+    bool served = daemon.Serve(fi.DaemonSocket());
+    stats.WriteCsv("fi_stats");
+    return served ? 0 : -1;
+  }
+
+  const uint64_t first = fi.IterationStart();
+  // Faults of each observed failure, see `lookup` of the daemon
+  FaultDictionaryWriter dict("fi_faults.dict");
+
+  // Run the iterations in parallel with the fastest configuration of the host,
+  // which is measured once and stored in the tuning file
+  if (!fi.TuningFile().empty()) {
+    std::mutex stats_mutex;
+    // The runs of the calibration are repeated afterwards
+    bool record = false;
+    auto run = [&](unsigned int threads, uint64_t i) {
+      // Each worker thread builds its own model once
+      thread_local std::unique_ptr<FaultInjection> fi_run;
+      thread_local std::unique_ptr<FullInvestigation> full;
+      if (!full) {
+        fi_run.reset(new FaultInjection(fi));
+        full.reset(new FullInvestigation(fi_run.get(), false, threads));
+      }
+      if (i == ParallelTuner::kGoldenRun) {
+        // No fault is inserted in cycle 0
+        fi_run->UpdateSpace(Fault{0, 0});
+      } else {
+        fi_run->UpdateSpace(i);
+      }
+      full->Run();
+      if (record) {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        stats.Record(*fi_run);
+        dict.Add(*fi_run);
+      }
+    };
+#if defined(VERILATOR_VERSION_INTEGER) && VERILATOR_VERSION_INTEGER >= 5000000
+    ParallelTuner tuner(run, FULL_MODEL_THREADS);
+#else
+    // The threads of the model can not be changed
+    ParallelTuner tuner(run, 1);
+#endif
+    struct ParallelConfig config;
+    if (!ParallelTuner::Load(fi.TuningFile(), "example_full", config)) {
+      config = tuner.Calibrate(16, first);
+      ParallelTuner::Store(fi.TuningFile(), "example_full", config);
+    }
+    std::cout << "Running " << config.concurrent_runs << " runs with "
+              << config.model_threads << " model threads in parallel"
+              << std::endl;
+    record = true;
+    tuner.Run(config, first, first + fi.IterationLength());
+    stats.WriteCsv("fi_stats");
+    dict.Compact();
+    return 0;
+  }
 
-    FullInvestigation full(&fi);
+  // Prefer faults close to faults which changed the path through the FSM or,
+  // with the `sim_coverage` target, hit other coverage points
+  if (!fi.CorpusFile().empty()) {
+    CoverageScheduler scheduler(fi.GetFullSpace());
+    scheduler.LoadCorpus(fi.CorpusFile());
+    CoverageMap coverage;
+    FullInvestigation full(&fi, false);
+    full.SetCoverage(&coverage);
+    struct Fault f;
+    for (uint64_t i = 0; i < fi.IterationLength() && scheduler.Next(f); ++i) {
+      fi.UpdateSpace(f);
+      full.Run();
+      scheduler.Report(f, fi.Outcome(), coverage.Commit());
+      stats.Record(fi);
+      dict.Add(fi);
+    }
+    std::cout << scheduler.Corpus().size() << " faults in the corpus, "
+              << coverage.Size() << " features covered" << std::endl;
+    scheduler.SaveCorpus(fi.CorpusFile());
+    stats.WriteCsv("fi_stats");
+    dict.Compact();
+    return 0;
+  }
+
+  FullInvestigation full(&fi);
+  for (uint64_t i = first; i < first + fi.IterationLength(); ++i) {
+    fi.UpdateSpace(i);
+    std::cout << "Starting simulation with fault injection config: "
+              << fi.GetFaultSpace() << std::endl;
 
     full.Run();
+
+    std::cout << fi << std::endl;
+
+    stats.Record(fi);
+    dict.Add(fi);
   }
 
+  stats.WriteCsv("fi_stats");
+  dict.Compact();
+
   fi_log.close();
 
   return 0;
@@ -2,6 +2,11 @@ yosys "read_verilog -sv rtl/top.sv"
 yosys "hierarchy -check -top top"
 yosys "proc"
 yosys "clean"
-yosys "addFi"
+# Additional options of addFi, e.g. `-local', from the environment
+set fi_args ""
+if {[info exists ::env(FI_ARGS)]} {
+    set fi_args $::env(FI_ARGS)
+}
+yosys "addFi $fi_args"
 yosys "clean"
 yosys "write_verilog rtl/top_fi.v"
@@ -0,0 +1,40 @@
+// Memory with a single write port and a synchronous read port
+module top (
+  input logic clk,
+  input logic we_i,
+  input logic [3:0] waddr_i,
+  input logic [3:0] raddr_i,
+  input logic [7:0] wdata_i,
+  output logic [7:0] rdata_o
+);
+
+  ram u_ram (
+    .clk,
+    .we_i,
+    .waddr_i,
+    .raddr_i,
+    .wdata_i,
+    .rdata_o
+  );
+
+endmodule
+
+module ram (
+  input logic clk,
+  input logic we_i,
+  input logic [3:0] waddr_i,
+  input logic [3:0] raddr_i,
+  input logic [7:0] wdata_i,
+  output logic [7:0] rdata_o
+);
+
+  logic [7:0] mem [16];
+
+  always_ff @(posedge clk) begin
+    if (we_i) begin
+      mem[waddr_i] <= wdata_i;
+    end
+    rdata_o <= mem[raddr_i];
+  end
+
+endmodule
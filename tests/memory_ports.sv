@@ -0,0 +1,37 @@
+// Memories which are skipped by `-mem' or outside of the observation cone
+module top (
+  input logic clk,
+  input logic we_i,
+  input logic [3:0] waddr_i,
+  input logic [3:0] raddr_i,
+  input logic [7:0] wdata_i,
+  output logic [7:0] rdata_o,
+  output logic [7:0] dbg_o,
+  output logic [7:0] async_o
+);
+
+  // Read by `rdata_o'
+  logic [7:0] mem [16];
+  // Only read by the debug output
+  logic [7:0] dbg_mem [16];
+  // Written without a clock
+  logic [7:0] async_mem [4];
+
+  always_ff @(posedge clk) begin
+    if (we_i) begin
+      mem[waddr_i] <= wdata_i;
+      dbg_mem[waddr_i] <= ~wdata_i;
+    end
+    rdata_o <= mem[raddr_i];
+    dbg_o <= dbg_mem[raddr_i];
+  end
+
+  always_comb begin
+    if (we_i) begin
+      async_mem[waddr_i[1:0]] = wdata_i;
+    end
+  end
+
+  assign async_o = async_mem[raddr_i[1:0]];
+
+endmodule
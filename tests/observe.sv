@@ -0,0 +1,52 @@
+// Only parts of the design are visible at the outputs which are observed
+module top (
+  input logic clk,
+  input logic rst,
+  input logic [3:0] in_i,
+  output logic [3:0] out_o,
+  output logic [3:0] dbg_o
+);
+
+  logic [3:0] status;
+
+  observed u_observed (
+    .clk,
+    .rst,
+    .in_i,
+    .out_o,
+    .status_o(status)
+  );
+
+  // Debug logic, only visible at `dbg_o`
+  always_ff @(posedge clk or posedge rst) begin
+    if (rst) begin
+      dbg_o <= '0;
+    end else begin
+      dbg_o <= status ^ in_i;
+    end
+  end
+
+endmodule
+
+module observed (
+  input logic clk,
+  input logic rst,
+  input logic [3:0] in_i,
+  output logic [3:0] out_o,
+  output logic [3:0] status_o
+);
+
+  logic [3:0] data_q;
+
+  always_ff @(posedge clk or posedge rst) begin
+    if (rst) begin
+      data_q <= '0;
+    end else begin
+      data_q <= in_i + data_q;
+    end
+  end
+
+  assign out_o = data_q & in_i;
+  assign status_o = {^data_q, |data_q, &in_i, ^in_i};
+
+endmodule
@@ -0,0 +1,117 @@
+#include <verilated.h>
+
+#include <vector>
+
+#include "abort_watch.h"
+#include "counter_tb.h"
+
+// Signals are plain Verilator data types, set between the checks like a
+// model would after a clock cycle.
+struct Signals {
+  CData flags = 0;
+  SData state = 0;
+  IData level = 0;
+  VlWide<3> wide;
+};
+
+std::vector<size_t> Check(AbortWatchList &watches, size_t *stop) {
+  std::vector<size_t> asserted;
+  *stop = watches.Check([&asserted](size_t i) { asserted.push_back(i); });
+  return asserted;
+}
+
+void TestPredicates() {
+  Signals s;
+  for (int i = 0; i < 3; ++i) {
+    s.wide[i] = 0;
+  }
+  AbortWatchList watches;
+  const size_t masked =
+      watches.Add("state", &s.state, AbortPredicate::Equal(0x0a0, 0x0f0));
+  const size_t rising =
+      watches.Add("flags_rise", &s.flags, AbortPredicate::RisingEdge(0x2));
+  const size_t falling =
+      watches.Add("flags_fall", &s.flags, AbortPredicate::FallingEdge(0x1));
+  const size_t range =
+      watches.Add("level", &s.level, AbortPredicate::InRange(100, 200), 2);
+  // Bit 64 of a wide signal
+  const size_t wide = watches.Add("wide", &s.wide,
+                                  AbortPredicate::RisingEdge({0, 0, 1}));
+  size_t stop;
+
+  // A flag which is already set on the first check is no edge
+  s.flags = 0x3;
+  EXPECT(Check(watches, &stop).empty());
+  EXPECT(stop == AbortWatchList::kNone);
+
+  s.flags = 0x2;
+  EXPECT(Check(watches, &stop) == std::vector<size_t>{falling});
+  EXPECT(stop == falling);
+
+  // Asserted watches are only reported once
+  s.flags = 0x3;
+  s.state = 0x5a5;
+  s.level = 150;
+  EXPECT(Check(watches, &stop) == (std::vector<size_t>{masked, range}));
+
+  // After the reset, all watches can be asserted again, the edges restart
+  // from the current values and the delay counts again
+  watches.Reset();
+  s.flags = 0x1;
+  s.state = 0x0a0;
+  s.level = 201;
+  EXPECT(Check(watches, &stop) == std::vector<size_t>{masked});
+  EXPECT(stop == masked);
+
+  watches.Reset();
+  s.state = 0;
+  s.flags = 0x0;
+  EXPECT(Check(watches, &stop).empty());
+  s.flags = 0x2;
+  s.level = 100;
+  s.wide[2] = 1;
+  EXPECT(Check(watches, &stop) == (std::vector<size_t>{rising, range, wide}));
+  EXPECT(stop == rising);
+
+  // Only the range watch with a delay of two cycles
+  watches.Reset();
+  s.flags = 0;
+  s.wide[2] = 0;
+  s.level = 99;
+  EXPECT(Check(watches, &stop).empty());
+  s.level = 200;
+  EXPECT(Check(watches, &stop) == std::vector<size_t>{range});
+  EXPECT(stop == AbortWatchList::kNone);
+  Check(watches, &stop);
+  EXPECT(stop == AbortWatchList::kNone);
+  Check(watches, &stop);
+  EXPECT(stop == range);
+
+  // Scan does not change the assertion state
+  watches.Reset();
+  std::vector<size_t> met;
+  watches.Scan([&met](size_t i) { met.push_back(i); });
+  EXPECT(met == std::vector<size_t>{range});
+  EXPECT(Check(watches, &stop).empty());
+}
+
+// Many resets, the assertion state of earlier epochs must never leak
+void TestManyResets() {
+  CData signal = 1;
+  AbortWatchList watches;
+  watches.Add("signal", &signal, AbortPredicate::Equal(1));
+  size_t stop;
+  bool ok = true;
+  for (int i = 0; i < 100000; ++i) {
+    ok &= Check(watches, &stop).size() == 1;
+    ok &= Check(watches, &stop).empty();
+    watches.Reset();
+  }
+  EXPECT(ok);
+}
+
+int main(int argc, char **argv) {
+  TestPredicates();
+  TestManyResets();
+  return Finish("abort_watch_test");
+}
@@ -0,0 +1,163 @@
+#include <verilated.h>
+
+#include <cstdint>
+
+#include "Vthird.h"
+#include "Vtop.h"
+#include "boundary_replay.h"
+#include "expect.h"
+#include "fault_injection.h"
+
+// The full design is tests/top_level_combined.sv, the module `third` is
+// simulated alone. The boundary of the instance `u_sim_one.u_third` are the
+// ports in_i[1:0] and out_o[1:0] of `top`.
+const uint64_t kCycles = 20;
+// The AND and the XOR cell of `third`
+const unsigned int kSubBits = 2;
+
+// Inputs of the design in each cycle, derived from the simulation time so
+// a restored model continues with the same inputs
+CData Stimulus(uint64_t time) {
+  return static_cast<CData>((time * 7 + 3) & 0xf);
+}
+
+// Outputs of `third` without a fault
+CData Third(CData in) {
+  const int a = in & (in >> 1) & 1;
+  const int x = (in ^ (in >> 1)) & 1;
+  return static_cast<CData>(a | x << 1);
+}
+
+struct CombinedHarness {
+  // Record the inputs of the other instance, which the module model cannot
+  // reproduce
+  bool wrong_boundary = false;
+
+  void ResetFull(Vtop &m, VerilatedContext &c) {
+    c.time(0);
+    m.fi_combined = 0;
+    m.in_i = Stimulus(0);
+    m.eval();
+  }
+  void StepFull(Vtop &m, VerilatedContext &c) {
+    c.timeInc(1);
+    m.in_i = Stimulus(c.time());
+    m.eval();
+  }
+  void CaptureBoundary(Vtop &m, EData *inputs, EData *outputs) {
+    inputs[0] = (wrong_boundary ? m.in_i >> 2 : m.in_i) & 0x3;
+    outputs[0] = m.out_o & 0x3;
+  }
+  void ResetSub(Vthird &m, VerilatedContext &c) {
+    c.time(0);
+    m.fi_comb = 0;
+    m.in_i = Stimulus(0) & 0x3;
+    m.eval();
+  }
+  void StepSub(Vthird &m, VerilatedContext &c, const EData *before,
+               const EData *after) {
+    c.timeInc(1);
+    m.in_i = static_cast<CData>(after[0]);
+    m.eval();
+  }
+  void SubOutputs(Vthird &m, EData *outputs) { outputs[0] = m.out_o; }
+  void SetSubFault(Vthird &m, uint64_t spatial, bool active) {
+    SetFaultBit(m.fi_comb, spatial, active);
+  }
+  void RunFull(Vtop &m, VerilatedContext &c, FaultInjection &fi) {
+    while (fi.Cycle() < kCycles) {
+      fi.UpdateInsert(m.fi_combined);
+      StepFull(m, c);
+      if (fi.StopRequested()) {
+        break;
+      }
+    }
+  }
+};
+
+// Position of the bits of `u_sim_one.u_third` in the fault bus of the full
+// design: the bits with the same effect on out_o[1:0] for all inputs as the
+// bits of the module model
+uint64_t FindOffset(Vtop &top, Vthird &third) {
+  const unsigned int width = sizeof(top.fi_combined) * 8;
+  uint64_t offset = width;
+  for (unsigned int b = 0; b + kSubBits <= width && offset == width; ++b) {
+    bool same = true;
+    for (unsigned int s = 0; s < kSubBits; ++s) {
+      for (CData in = 0; in < 16; ++in) {
+        top.fi_combined = 0;
+        SetFaultBit(top.fi_combined, b + s, true);
+        top.in_i = in;
+        top.eval();
+        third.fi_comb = 0;
+        SetFaultBit(third.fi_comb, s, true);
+        third.in_i = in & 0x3;
+        third.eval();
+        same &= (top.out_o & 0x3) == third.out_o;
+      }
+    }
+    if (same) {
+      offset = b;
+    }
+  }
+  top.fi_combined = 0;
+  third.fi_comb = 0;
+  return offset;
+}
+
+// Every fault of the module gives the outcome of a run of the full design
+void TestReplay(bool wrong_boundary) {
+  VerilatedContext top_context, third_context;
+  Vtop top{&top_context, "TOP"};
+  Vthird third{&third_context, "TOP"};
+  const uint64_t offset = FindOffset(top, third);
+  EXPECT(offset < sizeof(top.fi_combined) * 8);
+
+  CombinedHarness harness;
+  harness.wrong_boundary = wrong_boundary;
+  FaultInjection fi(sizeof(top.fi_combined) * 8);
+  // A fault inside the module is visible at its outputs
+  fi.AddValueComparator("out_o", [&](uint64_t &value) {
+    value = top.out_o & 0x3;
+    return value != Third(top.in_i & 0x3);
+  });
+
+  BoundaryReplay<Vtop, Vthird, CombinedHarness> replay(
+      harness, &top, &top_context, &third, &third_context, offset, 1, 1, 4);
+  EXPECT(replay.Record(kCycles) == !wrong_boundary);
+
+  uint64_t injected = 0;
+  for (uint64_t t = 1; t <= kCycles + 2; ++t) {
+    for (uint64_t s = 0; s < kSubBits; ++s) {
+      BoundaryReplay<Vtop, Vthird, CombinedHarness>::Result r =
+          replay.Run(Fault{t, s}, fi);
+
+      fi.UpdateSpace(Fault{t, offset + s});
+      harness.ResetFull(top, top_context);
+      harness.RunFull(top, top_context, fi);
+      EXPECT(r.outcome == fi.Outcome());
+      if (t > kCycles) {
+        // Not injected within the recording, the module model suffices
+        EXPECT(r.outcome == FaultOutcome::kNotInjected);
+        EXPECT(r.escalated == wrong_boundary);
+        continue;
+      }
+      // A flipped cell output of `third` always leaves the module
+      injected++;
+      EXPECT(r.outcome == FaultOutcome::kDataMatch);
+      EXPECT(r.escalated);
+      EXPECT(r.divergence == (wrong_boundary ? 0 : t));
+    }
+  }
+  EXPECT(replay.Runs() == (kCycles + 2) * kSubBits);
+  EXPECT(replay.Escalations() ==
+         (wrong_boundary ? replay.Runs() : injected));
+  top.final();
+  third.final();
+}
+
+int main(int argc, char **argv) {
+  TestReplay(false);
+  TestReplay(true);
+  return Finish("boundary_test");
+}
@@ -0,0 +1,69 @@
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "checkpoint_ladder.h"
+#include "counter_tb.h"
+
+// Larger than the buffer of `VerilatedDeserialize`, so `fill` is called with
+// a partially consumed buffer.
+void TestMemoryRoundTrip() {
+  std::vector<uint32_t> data(300 * 1024);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<uint32_t>(i * 2654435761u);
+  }
+  std::vector<uint8_t> bytes;
+  {
+    MemorySerialize os(&bytes);
+    for (size_t i = 0; i < data.size(); i += 1000) {
+      size_t n = std::min<size_t>(1000, data.size() - i);
+      os.write(&data[i], n * sizeof(uint32_t));
+    }
+  }
+  EXPECT(bytes.size() == data.size() * sizeof(uint32_t));
+
+  std::vector<uint32_t> read(data.size());
+  MemoryDeserialize is(bytes.data(), bytes.size());
+  for (size_t i = 0; i < read.size(); i += 700) {
+    size_t n = std::min<size_t>(700, read.size() - i);
+    is.read(&read[i], n * sizeof(uint32_t));
+  }
+  EXPECT(read == data);
+}
+
+// A restored model continues exactly like the golden run
+void TestLadderRestore(unsigned int keyframe_interval) {
+  VerilatedContext context;
+  Vcounter model{&context, "TOP"};
+  CheckpointLadder<Vcounter> ladder(&model, &context, 4, keyframe_interval);
+
+  std::vector<uint8_t> golden;
+  std::vector<uint64_t> time;
+  Reset(model, context);
+  for (uint64_t c = 0; c <= 40; ++c) {
+    ladder.Capture(c);
+    golden.push_back(model.count);
+    time.push_back(context.time());
+    Step(model, context);
+  }
+  EXPECT(ladder.Count() == 11);
+
+  for (uint64_t t : {0, 3, 10, 17, 40}) {
+    uint64_t cycle;
+    EXPECT(ladder.Restore(t, cycle));
+    EXPECT(cycle == t - t % 4);
+    EXPECT(context.time() == time[cycle]);
+    for (uint64_t c = cycle; c <= 40; ++c) {
+      EXPECT(model.count == golden[c]);
+      Step(model, context);
+    }
+  }
+  model.final();
+}
+
+int main(int argc, char **argv) {
+  TestMemoryRoundTrip();
+  TestLadderRestore(1);
+  TestLadderRestore(3);
+  return Finish("checkpoint_test");
+}
@@ -0,0 +1,29 @@
+module counter (
+  input logic clk,
+  input logic rst_n,
+  input logic [7:0] fi,
+  output logic [7:0] count,
+  output logic alert,
+  output logic window
+);
+  logic [7:0] history [16];
+
+  always_ff @(posedge clk or negedge rst_n) begin
+    if (!rst_n) begin
+      count <= '0;
+    end else begin
+      count <= (count + 8'd1) ^ fi;
+    end
+  end
+
+  // Some state which changes rarely, for the difference of snapshots
+  always_ff @(posedge clk) begin
+    history[count[3:0]] <= count;
+  end
+
+  assign alert = count == 8'hff;
+
+  // Level condition which holds for several cycles, twice
+  assign window = (count >= 8'd5 && count <= 8'd12) ||
+                  (count >= 8'd20 && count <= 8'd25);
+endmodule
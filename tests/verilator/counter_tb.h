@@ -0,0 +1,31 @@
+#ifndef COUNTER_TB_H_
+#define COUNTER_TB_H_
+
+#include <verilated.h>
+
+#include "Vcounter.h"
+#include "expect.h"
+
+// Drive the counter into the state of cycle 0
+inline void Reset(Vcounter &m, VerilatedContext &c) {
+  m.clk = 0;
+  m.fi = 0;
+  m.rst_n = 0;
+  m.eval();
+  c.timeInc(1);
+  m.rst_n = 1;
+  m.eval();
+  c.timeInc(1);
+}
+
+// Simulate one clock cycle
+inline void Step(Vcounter &m, VerilatedContext &c) {
+  m.clk = 1;
+  m.eval();
+  c.timeInc(1);
+  m.clk = 0;
+  m.eval();
+  c.timeInc(1);
+}
+
+#endif  // COUNTER_TB_H_
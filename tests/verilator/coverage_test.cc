@@ -0,0 +1,106 @@
+#include <atomic>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+#include "counter_tb.h"
+#include "coverage_scheduler.h"
+
+void TestCoverageMap() {
+  CoverageMap map(8);
+  // Transitions 0->1, 1->2, 2->3
+  for (uint64_t v : {1, 2, 3}) {
+    map.Observe(v);
+  }
+  uint64_t found = map.Commit();
+  EXPECT(found >= 1 && found <= 3);
+  EXPECT(map.Size() == found);
+  // The same path again is nothing new
+  for (uint64_t v : {1, 2, 3}) {
+    map.Observe(v);
+  }
+  EXPECT(map.Commit() == 0);
+
+  // Counters with the same bucket are the same feature
+  uint32_t counters[4] = {0, 1, 5, 0};
+  map.ObserveCounters(counters);
+  EXPECT(map.Commit() > 0);
+  counters[2] = 7;
+  map.ObserveCounters(counters);
+  EXPECT(map.Commit() == 0);
+  // Atomic counters of a model with `--threads`
+  std::atomic<uint32_t> atomic_counters[4];
+  for (auto &c : atomic_counters) {
+    c = 0;
+  }
+  atomic_counters[2] = 9;
+  map.ObserveCounters(atomic_counters);
+  EXPECT(map.Commit() == 1);
+
+  // The size is limited instead of shifting beyond 64 bits
+  CoverageMap large(64);
+  large.Observe(1);
+  EXPECT(large.Commit() == 1);
+  CoverageMap small(0);
+  small.Observe(1);
+  small.Observe(2);
+  small.Observe(3);
+  EXPECT(small.Commit() <= 2);
+}
+
+// Every fault is selected exactly once, whether it is explored, a neighbour
+// or part of a loaded corpus
+void TestSelectOnce(double exploration) {
+  FaultSpace space(3, 37, 5, 1);
+  CoverageScheduler scheduler(space, 7);
+  scheduler.SetExploration(exploration);
+  std::set<uint64_t> seen;
+  struct Fault f;
+  bool unique = true;
+  uint64_t runs = 0;
+  while (scheduler.Next(f)) {
+    EXPECT(space.Contains(f));
+    unique &= seen.insert(space.IndexOf(f)).second;
+    // Every seventh run is interesting
+    bool interesting = runs++ % 7 == 0;
+    scheduler.Report(f,
+                     interesting ? FaultOutcome::kDataMatch
+                                 : FaultOutcome::kNoEffect,
+                     0);
+  }
+  EXPECT(unique);
+  EXPECT(seen.size() == space.Size());
+  EXPECT(scheduler.Selected() == space.Size());
+  EXPECT(!scheduler.Corpus().empty());
+}
+
+// Neighbours of an entry with a high energy are selected more often
+void TestEnergy() {
+  FaultSpace space(0, 1000, 8);
+  CoverageScheduler scheduler(space, 3);
+  scheduler.SetExploration(0.0);
+  scheduler.SetRadius(20, 0);
+  struct Fault f;
+  // The first fault is explored, the corpus is empty
+  EXPECT(scheduler.Next(f));
+  scheduler.Report(Fault{100, 1}, FaultOutcome::kNoEffect, 1);
+  scheduler.Report(Fault{800, 6}, FaultOutcome::kNoEffect, 40);
+  EXPECT(scheduler.Corpus().size() == 2);
+  unsigned int near_high = 0;
+  for (int i = 0; i < 8; ++i) {
+    EXPECT(scheduler.Next(f));
+    near_high += f.spatial == 6;
+    // Keep the energies, reports of other faults do not change them
+    scheduler.Report(Fault{0, 0}, FaultOutcome::kNoEffect, 0);
+  }
+  EXPECT(near_high >= 6);
+}
+
+int main(int argc, char **argv) {
+  TestCoverageMap();
+  TestSelectOnce(0.2);
+  TestSelectOnce(0.0);
+  TestSelectOnce(1.0);
+  TestEnergy();
+  return Finish("coverage_test");
+}
@@ -0,0 +1,153 @@
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "campaign_daemon.h"
+#include "counter_tb.h"
+#include "fault_dictionary.h"
+#include "fault_injection.h"
+
+// Send a request and return the reply up to the final `ok` or `error` line
+std::string Request(int fd, const std::string &request) {
+  send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+  std::string reply;
+  char buffer[1024];
+  while (true) {
+    size_t last = reply.rfind('\n', reply.size() - 2);
+    last = last == std::string::npos ? 0 : last + 1;
+    if (!reply.empty() && reply.back() == '\n' &&
+        (reply.compare(last, 3, "ok\n") == 0 ||
+         reply.compare(last, 6, "error ") == 0)) {
+      return reply;
+    }
+    ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) {
+      return reply;
+    }
+    reply.append(buffer, n);
+  }
+}
+
+int Connect(const std::string &path) {
+  struct sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  // Wait until the daemon listens
+  for (int i = 0; i < 100; ++i) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                sizeof(addr)) == 0) {
+      return fd;
+    }
+    close(fd);
+    usleep(10000);
+  }
+  return -1;
+}
+
+// Faults and batches outside of the configured space are rejected without a
+// run
+void TestRunOutsideOfSpace() {
+  VerilatedContext context;
+  Vcounter model{&context, "TOP"};
+  FaultInjection fi(8);
+  // Cycles [2, 22) of the 8 bits of the fault bus
+  fi.SetModeRange(2, 20, true, 1);
+  CampaignDaemon daemon(fi, [&](FaultInjection &f) {
+    Reset(model, context);
+    model.fi = 0;
+    while (f.Cycle() < 30) {
+      f.UpdateInsert(model.fi);
+      Step(model, context);
+    }
+  });
+  const std::string path =
+      "/tmp/fifoss_daemon_test_" + std::to_string(getpid()) + ".sock";
+  std::thread server([&]() { daemon.Serve(path); });
+
+  int fd = Connect(path);
+  EXPECT(fd >= 0);
+  if (fd >= 0) {
+    EXPECT(Request(fd, "run 1 0\n").compare(0, 6, "error ") == 0);
+    EXPECT(Request(fd, "run 22 0\n").compare(0, 6, "error ") == 0);
+    EXPECT(Request(fd, "run 5 8\n").compare(0, 6, "error ") == 0);
+    EXPECT(daemon.Runs() == 0);
+    std::string reply = Request(fd, "run 5 3\n");
+    EXPECT(reply.compare(0, 7, "result ") == 0);
+    EXPECT(reply.find(" 5 3 no_effect ") != std::string::npos);
+    EXPECT(reply.find("ok\n") != std::string::npos);
+    EXPECT(daemon.Runs() == 1);
+    // 160 faults, the last batch would overflow `first + count`
+    EXPECT(Request(fd, "batch 150 11\n").compare(0, 6, "error ") == 0);
+    EXPECT(Request(fd, "batch 0 161\n").compare(0, 6, "error ") == 0);
+    EXPECT(Request(fd, "batch 2 18446744073709551615\n")
+               .compare(0, 6, "error ") == 0);
+    EXPECT(daemon.Runs() == 1);
+    reply = Request(fd, "batch 150 10\n");
+    EXPECT(reply.find("result 159 ") != std::string::npos);
+    EXPECT(reply.find("ok\n") != std::string::npos);
+    EXPECT(daemon.Runs() == 11);
+    EXPECT(Request(fd, "lookup 7 match 0 0xac\n") ==
+           "error no fault dictionary\n");
+    EXPECT(Request(fd, "shutdown\n") == "ok\n");
+    close(fd);
+  }
+  server.join();
+  model.final();
+}
+
+// The faults of a failure are looked up in the dictionary of the daemon
+void TestLookup() {
+  const std::string dict_path =
+      "/tmp/fifoss_daemon_test_" + std::to_string(getpid()) + ".dict";
+  {
+    FaultDictionaryWriter writer(dict_path);
+    writer.Add(
+        FailureSignature::FromObservation(7, EventKind::kDataMatch, 0xac, 0),
+        12);
+    writer.Add(
+        FailureSignature::FromObservation(7, EventKind::kDataMatch, 0xac, 0),
+        3);
+    writer.Add(
+        FailureSignature::FromObservation(9, EventKind::kAbortDetected, 0, 1),
+        5);
+  }
+  FaultInjection fi(8);
+  fi.SetModeRange(2, 20, true, 1);
+  FaultDictionary dict;
+  EXPECT(dict.Open(dict_path));
+  CampaignDaemon daemon(fi, [](FaultInjection &) {});
+  daemon.SetDictionary(&dict);
+  const std::string path =
+      "/tmp/fifoss_daemon_test_" + std::to_string(getpid()) + "_dict.sock";
+  std::thread server([&]() { daemon.Serve(path); });
+
+  int fd = Connect(path);
+  EXPECT(fd >= 0);
+  if (fd >= 0) {
+    EXPECT(Request(fd, "lookup 7 match 0 0xac\n") ==
+           "fault 3 2 3\nfault 12 3 4\nok\n");
+    EXPECT(Request(fd, "lookup 9 abort 1\n") == "fault 5 2 5\nok\n");
+    EXPECT(Request(fd, "lookup 9 abort 0\n") == "ok\n");
+    EXPECT(Request(fd, "lookup 9 stop 0\n").compare(0, 6, "error ") == 0);
+    EXPECT(Request(fd, "lookup 7 match 0 0xzz\n").compare(0, 6, "error ") ==
+           0);
+    EXPECT(daemon.Runs() == 0);
+    EXPECT(Request(fd, "shutdown\n") == "ok\n");
+    close(fd);
+  }
+  server.join();
+  unlink((dict_path + ".log").c_str());
+}
+
+int main(int argc, char **argv) {
+  TestRunOutsideOfSpace();
+  TestLookup();
+  return Finish("daemon_test");
+}
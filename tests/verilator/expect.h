@@ -0,0 +1,25 @@
+#ifndef EXPECT_H_
+#define EXPECT_H_
+
+#include <iostream>
+
+inline int &Failures() {
+  static int failures = 0;
+  return failures;
+}
+
+#define EXPECT(cond)                                                      \
+  do {                                                                    \
+    if (!(cond)) {                                                        \
+      std::cerr << __FILE__ << ":" << __LINE__ << ": FAILED: " #cond      \
+                << std::endl;                                             \
+      Failures()++;                                                       \
+    }                                                                     \
+  } while (0)
+
+inline int Finish(const char *name) {
+  std::cout << name << ": " << (Failures() ? "FAILED" : "ok") << std::endl;
+  return Failures() ? 1 : 0;
+}
+
+#endif  // EXPECT_H_
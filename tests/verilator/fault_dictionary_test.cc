@@ -0,0 +1,114 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "counter_tb.h"
+#include "fault_dictionary.h"
+#include "fault_injection.h"
+
+// Simulate the counter with the fault configured in `fi`
+void Run(FaultInjection &fi, Vcounter &model, VerilatedContext &context) {
+  Reset(model, context);
+  while (fi.Cycle() < 30) {
+    fi.UpdateInsert(model.fi);
+    Step(model, context);
+    if (fi.StopRequested()) {
+      break;
+    }
+  }
+}
+
+bool LookupAll(const FaultDictionary &dict,
+               const std::map<uint64_t, std::vector<uint64_t>> &expected) {
+  bool ok = true;
+  for (auto &e : expected) {
+    ok &= dict.Lookup(e.first) == e.second;
+  }
+  return ok;
+}
+
+// Write the results of all faults, look them up in the log, in the compacted
+// index and after more entries were added
+void TestRoundTrip() {
+  VerilatedContext context;
+  Vcounter model{&context, "TOP"};
+  FaultInjection fi(8);
+  // Cycles [2, 12) of the 8 bits of the fault bus
+  fi.SetModeRange(2, 10, true, 1);
+  // The counter counts the cycles until a fault changes it
+  fi.AddValueComparator("count", [&](uint64_t &value) {
+    value = model.count;
+    return model.count != (fi.Cycle() & 0xff);
+  });
+
+  const std::string path =
+      "/tmp/fifoss_dictionary_test_" + std::to_string(getpid()) + ".dict";
+  std::map<uint64_t, std::vector<uint64_t>> expected;
+  {
+    FaultDictionaryWriter writer(path);
+    writer.SetCompactThreshold(0);
+    for (uint64_t i = 0; i < fi.GetFullSpace().Size(); ++i) {
+      fi.UpdateSpace(i);
+      Run(fi, model, context);
+      EXPECT(fi.Outcome() == FaultOutcome::kDataMatch);
+      EXPECT(writer.Add(fi));
+      expected[FailureSignature::FromEvents(fi.Events()).Hash()].push_back(
+          fi.FaultId());
+    }
+    EXPECT(expected.size() > 1);
+
+    // Faults outside of the space have no id
+    fi.UpdateSpace(Fault{20, 1});
+    Run(fi, model, context);
+    EXPECT(!writer.Add(fi));
+    // Runs without a failure are not stored
+    EXPECT(writer.Add(FailureSignature{0, 0, FailureSignature::kNoFailure}, 3));
+
+    // Only the log
+    FaultDictionary dict;
+    EXPECT(dict.Open(path));
+    EXPECT(dict.NumSignatures() == 0);
+    EXPECT(LookupAll(dict, expected));
+    EXPECT(dict.Lookup(FailureSignature{0, 0, FailureSignature::kNoFailure})
+               .empty());
+
+    // The memory mapped index, in an open and a new dictionary
+    EXPECT(writer.Compact());
+    EXPECT(dict.Refresh());
+    EXPECT(dict.NumSignatures() == expected.size());
+    EXPECT(LookupAll(dict, expected));
+    FaultDictionary reopened;
+    EXPECT(reopened.Open(path));
+    EXPECT(LookupAll(reopened, expected));
+
+    // A signature from an observation finds the faults of its failure
+    fi.UpdateSpace(Fault{5, 2});
+    Run(fi, model, context);
+    std::vector<uint64_t> ids = reopened.Lookup(
+        FailureSignature::FromObservation(5, EventKind::kDataMatch, 5 ^ 4, 0));
+    EXPECT(std::find(ids.begin(), ids.end(), fi.FaultId()) != ids.end());
+
+    // New entries are merged with the index
+    const uint64_t first = expected.begin()->first;
+    EXPECT(writer.Add(FailureSignature::FromEvents(fi.Events()), 1000));
+    expected[FailureSignature::FromEvents(fi.Events()).Hash()].push_back(1000);
+    EXPECT(reopened.Refresh());
+    EXPECT(LookupAll(reopened, expected));
+    EXPECT(writer.Compact());
+    EXPECT(reopened.Refresh());
+    EXPECT(LookupAll(reopened, expected));
+    EXPECT(reopened.Lookup(first) == expected[first]);
+  }
+  unlink(path.c_str());
+  unlink((path + ".log").c_str());
+  model.final();
+}
+
+int main(int argc, char **argv) {
+  TestRoundTrip();
+  return Finish("fault_dictionary_test");
+}
@@ -0,0 +1,101 @@
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "counter_tb.h"
+#include "fault_space.h"
+
+// Permute must visit every index of the space exactly once
+void TestPermuteBijective() {
+  const uint64_t widths[] = {1, 3, 7, 10};
+  const uint64_t durations[] = {1, 2, 5, 13, 33, 100, 413};
+  for (uint64_t width : widths) {
+    for (uint64_t duration : durations) {
+      for (uint64_t seed = 0; seed < 3; ++seed) {
+        FaultSpace space(4, duration, width, seed);
+        EXPECT(space.Size() == duration * width);
+        std::vector<bool> seen(space.Size(), false);
+        bool bijective = true;
+        for (uint64_t i = 0; i < space.Size(); ++i) {
+          uint64_t p = space.Permute(i);
+          bijective &= p < space.Size() && !seen[p];
+          if (p < space.Size()) {
+            seen[p] = true;
+          }
+          // Indices beyond the space are wrapped
+          bijective &= space.Permute(i + space.Size()) == p;
+          bijective &= space.Unpermute(p) == i;
+          bijective &= space.Contains(space.RandomAt(i));
+        }
+        EXPECT(bijective);
+      }
+    }
+  }
+  // The order depends on the seed
+  FaultSpace a(0, 1000, 3, 1);
+  FaultSpace b(0, 1000, 3, 2);
+  bool differs = false;
+  for (uint64_t i = 0; i < 16; ++i) {
+    differs |= a.Permute(i) != b.Permute(i);
+  }
+  EXPECT(differs);
+}
+
+void TestIndex() {
+  FaultSpace space(10, 4, 3);
+  EXPECT(space.At(0).temporal == 10 && space.At(0).spatial == 0);
+  EXPECT(space.At(5).temporal == 11 && space.At(5).spatial == 2);
+  EXPECT(space.IndexOf(Fault{13, 2}) == 11);
+  EXPECT(space.Contains(Fault{13, 2}));
+  EXPECT(!space.Contains(Fault{14, 0}));
+  EXPECT(!space.Contains(Fault{9, 0}));
+  EXPECT(!space.Contains(Fault{10, 3}));
+}
+
+void TestOverflow() {
+  const uint64_t max = std::numeric_limits<uint64_t>::max();
+  FaultSpace space(0, max, 10);
+  EXPECT(space.Size() == max / 10 * 10);
+  EXPECT(space.Permute(12345) < space.Size());
+  EXPECT(FaultSpace(0, max, 1).Size() == max);
+}
+
+void TestSplit() {
+  const uint64_t lengths[] = {0, 1, 7, 64, 1001};
+  const unsigned int parts[] = {1, 2, 3, 8, 13};
+  for (uint64_t length : lengths) {
+    for (unsigned int n : parts) {
+      std::vector<FaultSpace::Range> ranges =
+          FaultSpace::SplitRange(5, 5 + length, n);
+      EXPECT(ranges.size() == n);
+      // Consecutive, covering and at most one element difference in length
+      uint64_t next = 5;
+      bool ok = true;
+      for (unsigned int i = 0; i < ranges.size(); ++i) {
+        const FaultSpace::Range &r = ranges[i];
+        ok &= r.begin == next && r.end >= r.begin;
+        ok &= r.end - r.begin == length / n ||
+              r.end - r.begin == length / n + 1;
+        FaultSpace::Range at = FaultSpace::RangeAt(5, 5 + length, n, i);
+        ok &= at.begin == r.begin && at.end == r.end;
+        next = r.end;
+      }
+      EXPECT(ok);
+      EXPECT(next == 5 + length);
+    }
+  }
+  EXPECT(FaultSpace::SplitRange(0, 10, 0).empty());
+  EXPECT(FaultSpace::SplitRange(10, 0, 2).empty());
+  std::vector<FaultSpace::Range> ranges = FaultSpace(0, 5, 2).Split(3);
+  EXPECT(ranges.size() == 3);
+  EXPECT(ranges[0].begin == 0 && ranges[0].end == 4);
+  EXPECT(ranges[2].begin == 7 && ranges[2].end == 10);
+}
+
+int main(int argc, char **argv) {
+  TestPermuteBijective();
+  TestIndex();
+  TestOverflow();
+  TestSplit();
+  return Finish("fault_space_test");
+}
@@ -0,0 +1,134 @@
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "counter_tb.h"
+#include "fault_injection.h"
+#include "lockstep_batch.h"
+
+const uint64_t kMaxCycles = 140;
+// Value of the counter treated as leaked data, the golden run never reaches
+// it
+const uint8_t kLeak = 0xa0;
+
+struct CounterHarness {
+  void Reset(Vcounter &m, VerilatedContext &c) { ::Reset(m, c); }
+  void Step(Vcounter &m, VerilatedContext &c) { ::Step(m, c); }
+  void SetFault(Vcounter &m, uint64_t spatial, bool active) {
+    SetFaultBit(m.fi, spatial, active);
+  }
+  uint64_t Observe(Vcounter &m) { return m.count; }
+  bool Abort(Vcounter &m) { return m.alert; }
+  bool Leak(Vcounter &m, uint64_t &value) {
+    value = m.count;
+    return m.count == kLeak;
+  }
+};
+
+struct Expected {
+  FaultOutcome outcome;
+  uint64_t divergence;
+  uint64_t cycles;
+};
+
+std::vector<struct Fault> Faults() {
+  std::vector<struct Fault> faults;
+  for (uint64_t t : {1, 3, 10, 33, 64, 100, 139, 150}) {
+    for (uint64_t s = 0; s < 8; ++s) {
+      faults.push_back(Fault{t, s});
+    }
+  }
+  return faults;
+}
+
+// Simulate the faults one after another with `FaultInjection`
+std::vector<struct Expected> Sequential(const std::vector<struct Fault> &faults,
+                                        unsigned int fault_length,
+                                        unsigned int abort_delay) {
+  VerilatedContext context;
+  Vcounter model{&context, "TOP"};
+  std::vector<uint8_t> golden;
+  Reset(model, context);
+  for (uint64_t c = 1; c <= kMaxCycles; ++c) {
+    Step(model, context);
+    golden.push_back(model.count);
+  }
+
+  FaultInjection fi(8);
+  fi.SetFaultDuration(fault_length);
+  fi.AddAbortWatch("alert", &model.alert, abort_delay);
+  fi.AddValueComparator("count", [&](uint64_t &value) {
+    value = model.count;
+    return model.count == kLeak;
+  });
+  std::vector<struct Expected> expected;
+  for (const struct Fault &f : faults) {
+    fi.UpdateSpace(f);
+    Reset(model, context);
+    uint64_t divergence = 0;
+    while (fi.Cycle() < kMaxCycles) {
+      fi.UpdateInsert(model.fi);
+      Step(model, context);
+      if (!divergence && model.count != golden[fi.Cycle() - 1]) {
+        divergence = fi.Cycle();
+      }
+      if (fi.StopRequested()) {
+        break;
+      }
+    }
+    expected.push_back(Expected{fi.Outcome(), divergence, fi.Cycle()});
+  }
+  model.final();
+  return expected;
+}
+
+// Every lane reports the result of the sequential run of its fault
+void TestMatchesSequential(unsigned int lanes, unsigned int fault_length,
+                           unsigned int abort_delay) {
+  const std::vector<struct Fault> faults = Faults();
+  const std::vector<struct Expected> expected =
+      Sequential(faults, fault_length, abort_delay);
+
+  CounterHarness harness;
+  LockstepBatch<Vcounter, CounterHarness> batch(harness, lanes, kMaxCycles,
+                                                fault_length, abort_delay);
+  size_t next = 0;
+  std::map<FaultOutcome, size_t> outcomes;
+  std::vector<int> seen(faults.size(), 0);
+  uint64_t runs = batch.Run(
+      [&](struct Fault &f, uint64_t &job) {
+        if (next >= faults.size()) {
+          return false;
+        }
+        f = faults[job = next++];
+        return true;
+      },
+      [&](const LockstepBatch<Vcounter, CounterHarness>::Result &r) {
+        const struct Expected &e = expected[r.job];
+        EXPECT(r.fault.temporal == faults[r.job].temporal);
+        EXPECT(r.fault.spatial == faults[r.job].spatial);
+        EXPECT(r.outcome == e.outcome);
+        EXPECT(r.divergence == e.divergence);
+        EXPECT(r.cycles == e.cycles);
+        seen[r.job]++;
+        outcomes[r.outcome]++;
+      });
+  EXPECT(runs == faults.size());
+  for (int s : seen) {
+    EXPECT(s == 1);
+  }
+  // Faults of one cycle lead to all outcomes, longer faults flip the bit back
+  if (fault_length == 1) {
+    EXPECT(outcomes.size() ==
+           static_cast<size_t>(FaultOutcome::kNumOutcomes));
+  }
+}
+
+int main(int argc, char **argv) {
+  TestMatchesSequential(1, 1, 0);
+  TestMatchesSequential(3, 1, 0);
+  TestMatchesSequential(3, 2, 0);
+  TestMatchesSequential(5, 1, 3);
+  TestMatchesSequential(8, 2, 7);
+  return Finish("lockstep_test");
+}
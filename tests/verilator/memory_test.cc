@@ -0,0 +1,100 @@
+#include <verilated.h>
+
+#include <cstdint>
+
+#include "Vmemory.h"
+#include "expect.h"
+#include "fault_injection.h"
+
+// The model is tests/memory.sv instrumented with `addFi -mem -no-ff -no-comb`,
+// so the memory fault bus only holds the side-band of `u_ram.mem`: 4 address
+// bits, 3 bit index bits and the enable.
+
+// Simulate one clock cycle, the memory fault bus is driven before the edge
+void Cycle(Vmemory &m, VerilatedContext &c, FaultInjection &fi) {
+  fi.AdvanceCycle();
+  fi.UpdateMemory(m.fi_mem_combined);
+  m.clk = 1;
+  m.eval();
+  c.timeInc(1);
+  m.clk = 0;
+  m.eval();
+  c.timeInc(1);
+}
+
+// Read a word, the read port is synchronous
+uint8_t Read(Vmemory &m, VerilatedContext &c, FaultInjection &fi,
+             uint8_t address) {
+  m.we_i = 0;
+  m.raddr_i = address;
+  Cycle(m, c, fi);
+  return m.rdata_o;
+}
+
+// Write `0x10 + address` to all words
+void Fill(Vmemory &m, VerilatedContext &c, FaultInjection &fi) {
+  for (uint8_t a = 0; a < 16; ++a) {
+    m.we_i = 1;
+    m.waddr_i = a;
+    m.wdata_i = 0x10 + a;
+    Cycle(m, c, fi);
+  }
+  m.we_i = 0;
+}
+
+bool Untouched(Vmemory &m, VerilatedContext &c, FaultInjection &fi,
+               uint8_t except) {
+  bool ok = true;
+  for (uint8_t a = 0; a < 16; ++a) {
+    if (a != except) {
+      ok &= Read(m, c, fi, a) == 0x10 + a;
+    }
+  }
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  VerilatedContext context;
+  Vmemory model{&context, "TOP"};
+  FaultInjection fi(0);
+  const size_t ram = fi.AddMemory("u_ram.mem", 0, 4, 3);
+  model.clk = 0;
+  model.eval();
+
+  // Run 1, the flip is applied in cycle 20 and visible from then on
+  fi.UpdateSpace(Fault{0, 0});
+  fi.ScheduleMemoryFlip(ram, 20, 5, 3);
+  Fill(model, context, fi);
+  EXPECT(fi.Cycle() == 16);
+  EXPECT(Read(model, context, fi, 5) == 0x15);
+  EXPECT(Read(model, context, fi, 5) == 0x15);
+  EXPECT(Read(model, context, fi, 5) == 0x15);
+  // The fault is written with the clock edge of cycle 20
+  EXPECT(Read(model, context, fi, 5) == 0x15);
+  EXPECT(Read(model, context, fi, 5) == (0x15 ^ 0x08));
+  EXPECT(fi.Outcome() == FaultOutcome::kNoEffect);
+  // The side-band is only enabled for one cycle and no other word changed
+  EXPECT(!(model.fi_mem_combined & 0x80));
+  EXPECT(Untouched(model, context, fi, 5));
+  EXPECT(Read(model, context, fi, 5) == (0x15 ^ 0x08));
+
+  // Run 2, a flip scheduled before `UpdateSpace` is removed
+  fi.ScheduleMemoryFlip(ram, 3, 5, 3);
+  fi.UpdateSpace(Fault{0, 0});
+  for (int i = 0; i < 10; ++i) {
+    EXPECT(Read(model, context, fi, 5) == (0x15 ^ 0x08));
+  }
+  EXPECT(fi.Outcome() == FaultOutcome::kNotInjected);
+
+  // Run 3, flipping the same bit again restores the word
+  fi.UpdateSpace(Fault{0, 0});
+  fi.ScheduleMemoryFlip(ram, 2, 5, 3);
+  Read(model, context, fi, 0);
+  Read(model, context, fi, 0);
+  EXPECT(Read(model, context, fi, 5) == 0x15);
+  EXPECT(Untouched(model, context, fi, 0xff));
+  EXPECT(fi.Outcome() == FaultOutcome::kNoEffect);
+
+  model.final();
+  return Finish("memory_test");
+}
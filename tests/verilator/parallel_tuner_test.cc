@@ -0,0 +1,88 @@
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "counter_tb.h"
+#include "parallel_tuner.h"
+
+void TestCandidates() {
+  ParallelTuner tuner([](unsigned int, uint64_t) {}, 3);
+  std::vector<struct ParallelConfig> candidates = tuner.Candidates();
+  EXPECT(!candidates.empty());
+  // All cores with single-threaded models
+  const unsigned int cores = candidates.front().concurrent_runs;
+  EXPECT(candidates.front().model_threads == 1);
+  bool fewer_runs = false;
+  bool all_threads = cores < 3;
+  for (auto &c : candidates) {
+    EXPECT(c.model_threads >= 1 && c.model_threads <= 3);
+    EXPECT(c.concurrent_runs >= 1);
+    EXPECT(c.model_threads * c.concurrent_runs <= cores);
+    fewer_runs |= c.model_threads * c.concurrent_runs < cores;
+    all_threads |= c.model_threads == 3;
+  }
+  EXPECT(fewer_runs || cores == 1);
+  EXPECT(all_threads);
+}
+
+// The cost of a run only depends on the model threads. Without the run
+// without a fault one model thread is the cheapest.
+void TestCalibrate() {
+  std::atomic<unsigned int> golden(0);
+  std::atomic<unsigned int> faulty(0);
+  auto run = [&](unsigned int threads, uint64_t i) {
+    unsigned int ms;
+    if (i == ParallelTuner::kGoldenRun) {
+      golden++;
+      ms = threads == 1 ? 200 : 10;
+    } else {
+      EXPECT(i >= 100 && i < 108);
+      faulty++;
+      ms = threads == 1 ? 1 : 2;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+  };
+  ParallelTuner tuner(run, 2);
+  std::vector<struct ParallelConfig> candidates{
+      ParallelConfig{1, 1, 0.0}, ParallelConfig{2, 1, 0.0}};
+  struct ParallelConfig best = tuner.Calibrate(candidates, 8, 100);
+  EXPECT(best.model_threads == 2);
+  EXPECT(golden == 2);
+  EXPECT(faulty == 16);
+  EXPECT(tuner.Results().size() == 2);
+  EXPECT(tuner.Results()[1].faults_per_second >
+         tuner.Results()[0].faults_per_second);
+
+  // The campaign itself has no run without a fault
+  golden = 0;
+  faulty = 0;
+  tuner.Run(ParallelConfig{1, 2, 0.0}, 100, 108);
+  EXPECT(golden == 0);
+  EXPECT(faulty == 8);
+}
+
+void TestStore() {
+  const std::string filename =
+      "/tmp/fifoss_tuner_test_" + std::to_string(getpid()) + ".txt";
+  EXPECT(ParallelTuner::Store(filename, "a", ParallelConfig{1, 4, 10.0}));
+  EXPECT(ParallelTuner::Store(filename, "b", ParallelConfig{2, 2, 20.0}));
+  EXPECT(ParallelTuner::Store(filename, "a", ParallelConfig{4, 1, 30.0}));
+  struct ParallelConfig c;
+  EXPECT(ParallelTuner::Load(filename, "a", c));
+  EXPECT(c.model_threads == 4 && c.concurrent_runs == 1);
+  EXPECT(ParallelTuner::Load(filename, "b", c));
+  EXPECT(c.model_threads == 2 && c.concurrent_runs == 2);
+  EXPECT(!ParallelTuner::Load(filename, "c", c));
+  unlink(filename.c_str());
+}
+
+int main(int argc, char **argv) {
+  TestCandidates();
+  TestCalibrate();
+  TestStore();
+  return Finish("parallel_tuner_test");
+}
@@ -0,0 +1,106 @@
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "campaign_statistics.h"
+#include "counter_tb.h"
+
+std::vector<std::string> ReadLines(const std::string &filename) {
+  std::ifstream is(filename);
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(is, line)) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+std::string Prefix(const char *name) {
+  return "/tmp/fifoss_statistics_test_" + std::to_string(getpid()) + "_" +
+         name;
+}
+
+// 4 bits, 3 buckets of 5 cycles starting at cycle 10, two modules
+CampaignStatistics Create() {
+  CampaignStatistics stats(4, 10, 5, 3);
+  stats.AddModule("low", 0, 2);
+  stats.AddModule("all", 0, 4);
+  return stats;
+}
+
+void RecordRuns(CampaignStatistics &stats) {
+  stats.Record(Fault{10, 0}, FaultOutcome::kAbort);
+  stats.Record(Fault{14, 0}, FaultOutcome::kNoEffect);
+  stats.Record(Fault{15, 1}, FaultOutcome::kDataMatch);
+  stats.Record(Fault{19, 3}, FaultOutcome::kNoEffect);
+  // Before and after the buckets
+  stats.Record(Fault{2, 2}, FaultOutcome::kNotInjected);
+  stats.Record(Fault{99, 3}, FaultOutcome::kAbort);
+  // Outside of the fault bus, only counted per cycle
+  stats.Record(Fault{20, 7}, FaultOutcome::kNoEffect);
+}
+
+void TestCounters() {
+  CampaignStatistics stats = Create();
+  RecordRuns(stats);
+  EXPECT(stats.Runs() == 7);
+  const std::string prefix = Prefix("counters");
+  EXPECT(stats.WriteCsv(prefix));
+
+  std::vector<std::string> bits = ReadLines(prefix + "_bits.csv");
+  EXPECT(bits.size() == 5);
+  EXPECT(bits[0] ==
+         "bit,not_injected,no_effect,abort,data_match,sensitivity");
+  EXPECT(bits[1] == "0,0,1,1,0,0.5");
+  EXPECT(bits[2] == "1,0,0,0,1,1");
+  EXPECT(bits[3] == "2,1,0,0,0,0");
+  EXPECT(bits[4] == "3,0,1,1,0,0.5");
+
+  std::vector<std::string> cycles = ReadLines(prefix + "_cycles.csv");
+  EXPECT(cycles.size() == 4);
+  EXPECT(cycles[0] == "cycle_start,cycle_end,not_injected,no_effect,abort,"
+                      "data_match,sensitivity");
+  EXPECT(cycles[1] == "10,14,1,1,1,0,0.5");
+  EXPECT(cycles[2] == "15,19,0,1,0,1,0.5");
+  EXPECT(cycles[3] == "20,24,0,1,1,0,0.5");
+
+  std::vector<std::string> modules = ReadLines(prefix + "_modules.csv");
+  EXPECT(modules.size() == 3);
+  EXPECT(modules[1] == "low,0,2,0,1,1,1,0.666667");
+  EXPECT(modules[2] == "all,0,4,1,2,2,1,0.6");
+}
+
+// Counters read from a checkpoint are written unchanged
+void TestCheckpointRoundTrip() {
+  const std::string prefix = Prefix("checkpoint");
+  CampaignStatistics stats = Create();
+  stats.SetCheckpoint(prefix, 3);
+  RecordRuns(stats);
+  // Checkpoint after 6 runs
+  CampaignStatistics resumed = Create();
+  EXPECT(resumed.ReadCsv(prefix));
+  EXPECT(resumed.Runs() == 6);
+  resumed.Record(Fault{20, 7}, FaultOutcome::kNoEffect);
+
+  const std::string a = Prefix("a");
+  const std::string b = Prefix("b");
+  EXPECT(stats.WriteCsv(a));
+  EXPECT(resumed.WriteCsv(b));
+  for (const char *file : {"_bits.csv", "_cycles.csv", "_modules.csv"}) {
+    EXPECT(ReadLines(a + file) == ReadLines(b + file));
+  }
+
+  // A different layout is rejected and the counters are kept
+  CampaignStatistics other(8, 10, 5, 3);
+  EXPECT(!other.ReadCsv(prefix));
+  EXPECT(other.Runs() == 0);
+}
+
+int main(int argc, char **argv) {
+  TestCounters();
+  TestCheckpointRoundTrip();
+  return Finish("statistics_test");
+}
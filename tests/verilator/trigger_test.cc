@@ -0,0 +1,79 @@
+#include <cstdint>
+
+#include "checkpoint_ladder.h"
+#include "counter_tb.h"
+#include "fault_injection.h"
+
+struct RunResult {
+  uint64_t trigger;
+  uint64_t injection;
+  // Cycle in which the fault bus was set
+  uint64_t inserted;
+};
+
+// Continue the run until `cycles`, taking snapshots if `ladder` is given
+struct RunResult Simulate(Vcounter &model, VerilatedContext &context,
+                          FaultInjection &fi, uint64_t cycles,
+                          CheckpointLadder<Vcounter> *ladder) {
+  struct RunResult r {
+    0, 0, 0
+  };
+  while (fi.Cycle() < cycles) {
+    if (ladder) {
+      ladder->Capture(fi.Cycle());
+    }
+    fi.UpdateInsert(model.fi);
+    if (model.fi && !r.inserted) {
+      r.inserted = fi.Cycle();
+    }
+    Step(model, context);
+  }
+  r.trigger = fi.TriggerCycle();
+  r.injection = fi.InjectionCycle();
+  return r;
+}
+
+// The second occurrence of a level condition is the trigger. A run restored
+// between both occurrences must not count the level at the restored cycle as
+// a new occurrence.
+void TestRestoreBetweenOccurrences() {
+  VerilatedContext context;
+  Vcounter model{&context, "TOP"};
+  CheckpointLadder<Vcounter> ladder(&model, &context, 2);
+  FaultInjection fi(8);
+  fi.SetTrigger("window", &model.window, AbortPredicate::Equal(1), 2);
+
+  fi.UpdateSpace(Fault{5, 0});
+  Reset(model, context);
+  struct RunResult first = Simulate(model, context, fi, 40, &ladder);
+  EXPECT(first.trigger > 15);
+  EXPECT(first.injection == first.trigger + 5);
+  EXPECT(first.inserted == first.injection);
+
+  // Restore inside of the first level and at the start of the second one
+  for (uint64_t t : {10, 14, 20}) {
+    fi.UpdateSpace(Fault{5, 0});
+    uint64_t cycle;
+    EXPECT(ladder.Restore(t, cycle));
+    fi.SetCycle(cycle);
+    model.fi = 0;
+    struct RunResult r = Simulate(model, context, fi, 40, nullptr);
+    EXPECT(r.trigger == first.trigger);
+    EXPECT(r.injection == first.injection);
+    EXPECT(r.inserted == first.inserted);
+  }
+
+  // Restored after the trigger
+  fi.UpdateSpace(Fault{5, 0});
+  EXPECT(ladder.Restore(fi));
+  model.fi = 0;
+  struct RunResult r = Simulate(model, context, fi, 40, nullptr);
+  EXPECT(r.trigger == first.trigger);
+  EXPECT(r.inserted == first.inserted);
+  model.final();
+}
+
+int main(int argc, char **argv) {
+  TestRestoreBetweenOccurrences();
+  return Finish("trigger_test");
+}
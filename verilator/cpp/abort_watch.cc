@@ -0,0 +1,139 @@
+#include "abort_watch.h"
+
+#include <algorithm>
+
+namespace {
+
+std::vector<EData> ToWords(QData value) {
+  return std::vector<EData>{static_cast<EData>(value),
+                            static_cast<EData>(value >> 32)};
+}
+
+EData WordAt(const std::vector<EData> &v, size_t i) {
+  return i < v.size() ? v[i] : 0;
+}
+
+// Unsigned comparison of multi-word values, -1, 0 or 1
+int CompareWords(const EData *value, const std::vector<EData> &limit,
+                 size_t words) {
+  size_t n = words > limit.size() ? words : limit.size();
+  for (size_t i = n; i-- > 0;) {
+    EData v = i < words ? value[i] : 0;
+    EData l = WordAt(limit, i);
+    if (v != l) {
+      return v < l ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+
+AbortPredicate AbortPredicate::Equal(QData value, QData mask) {
+  return AbortPredicate{Kind::kMasked, ToWords(value), ToWords(mask)};
+}
+
+AbortPredicate AbortPredicate::Equal(const std::vector<EData> &value,
+                                     const std::vector<EData> &mask) {
+  return AbortPredicate{Kind::kMasked, value, mask};
+}
+
+AbortPredicate AbortPredicate::RisingEdge(QData mask) {
+  return AbortPredicate{Kind::kRisingEdge, {}, ToWords(mask)};
+}
+
+AbortPredicate AbortPredicate::RisingEdge(const std::vector<EData> &mask) {
+  return AbortPredicate{Kind::kRisingEdge, {}, mask};
+}
+
+AbortPredicate AbortPredicate::FallingEdge(QData mask) {
+  return AbortPredicate{Kind::kFallingEdge, {}, ToWords(mask)};
+}
+
+AbortPredicate AbortPredicate::FallingEdge(const std::vector<EData> &mask) {
+  return AbortPredicate{Kind::kFallingEdge, {}, mask};
+}
+
+AbortPredicate AbortPredicate::InRange(QData low, QData high) {
+  return AbortPredicate{Kind::kRange, ToWords(low), ToWords(high)};
+}
+
+AbortPredicate AbortPredicate::InRange(const std::vector<EData> &low,
+                                       const std::vector<EData> &high) {
+  return AbortPredicate{Kind::kRange, low, high};
+}
+
+bool AbortPredicate::Evaluate(const EData *current, const EData *previous,
+                              size_t words) const {
+  switch (kind) {
+    case Kind::kMasked:
+      for (size_t i = 0; i < words; ++i) {
+        if ((current[i] ^ WordAt(a, i)) & WordAt(b, i)) {
+          return false;
+        }
+      }
+      return true;
+    case Kind::kRisingEdge:
+      for (size_t i = 0; i < words; ++i) {
+        if (~previous[i] & current[i] & WordAt(b, i)) {
+          return true;
+        }
+      }
+      return false;
+    case Kind::kFallingEdge:
+      for (size_t i = 0; i < words; ++i) {
+        if (previous[i] & ~current[i] & WordAt(b, i)) {
+          return true;
+        }
+      }
+      return false;
+    case Kind::kRange:
+      return CompareWords(current, a, words) >= 0 &&
+             CompareWords(current, b, words) <= 0;
+  }
+  return false;
+}
+
+size_t AbortWatchList::Add(const char *name, const void *signal, size_t bytes,
+                           const AbortPredicate &predicate,
+                           unsigned int delay) {
+  const size_t words = (bytes + sizeof(EData) - 1) / sizeof(EData);
+  watches_.push_back(
+      Watch{name, signal, bytes, words, shadow_.size(), predicate, delay});
+  shadow_.resize(shadow_.size() + words, 0);
+  if (scratch_.size() < words) {
+    scratch_.resize(words, 0);
+  }
+  asserted_epoch_.push_back(0);
+  delay_count_.push_back(0);
+  active_.reserve(watches_.size());
+  synchronized_ = false;
+  return watches_.size() - 1;
+}
+
+void AbortWatchList::Reset() {
+  if (++epoch_ == 0) {
+    // Wrapped around, stale epochs could match again
+    std::fill(asserted_epoch_.begin(), asserted_epoch_.end(), 0);
+    epoch_ = 1;
+  }
+  active_.clear();
+  synchronized_ = false;
+}
+
+// Returns true if the condition of watch `i` is met. The condition is only
+// evaluated if the signal changed or `force` is set.
+bool AbortWatchList::Update(size_t i, bool force) {
+  const struct Watch &w = watches_[i];
+  EData *shadow = &shadow_[w.offset];
+  if (!force && std::memcmp(w.signal, shadow, w.bytes) == 0) {
+    return false;
+  }
+  EData *current = scratch_.data();
+  current[w.words - 1] = 0;
+  std::memcpy(current, w.signal, w.bytes);
+  // No edge on the first evaluation
+  bool met = w.predicate.Evaluate(current, force ? current : shadow, w.words);
+  std::memcpy(shadow, current, w.words * sizeof(EData));
+  return met;
+}
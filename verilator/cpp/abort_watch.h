@@ -0,0 +1,175 @@
+#ifndef ABORT_WATCH_H_
+#define ABORT_WATCH_H_
+
+#include <verilated.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * Condition on a watched signal.
+ *
+ * Values are stored as 32-bit words like Verilator's wide signals. Values
+ * given as `QData` are zero extended to the width of the watched signal.
+ */
+struct AbortPredicate {
+  enum class Kind {
+    // (signal & mask) == (value & mask)
+    kMasked,
+    // Any bit of the mask changed from 0 to 1
+    kRisingEdge,
+    // Any bit of the mask changed from 1 to 0
+    kFallingEdge,
+    // low <= signal <= high, unsigned
+    kRange
+  };
+
+  Kind kind;
+  // Value for kMasked, low limit for kRange
+  std::vector<EData> a;
+  // Mask for kMasked and edges, high limit for kRange
+  std::vector<EData> b;
+
+  static AbortPredicate Equal(QData value, QData mask = ~0ULL);
+  static AbortPredicate Equal(const std::vector<EData> &value,
+                              const std::vector<EData> &mask);
+  static AbortPredicate RisingEdge(QData mask = ~0ULL);
+  static AbortPredicate RisingEdge(const std::vector<EData> &mask);
+  static AbortPredicate FallingEdge(QData mask = ~0ULL);
+  static AbortPredicate FallingEdge(const std::vector<EData> &mask);
+  static AbortPredicate InRange(QData low, QData high);
+  static AbortPredicate InRange(const std::vector<EData> &low,
+                                const std::vector<EData> &high);
+
+  /**
+   * Evaluate the condition for the current and previous signal value, both
+   * `words` long.
+   */
+  bool Evaluate(const EData *current, const EData *previous,
+                size_t words) const;
+};
+
+/**
+ * List of design signals which, when asserted, request a stop of the
+ * simulation.
+ *
+ * The last seen value of all signals is kept in a single shadow buffer. A
+ * condition is only evaluated if the signal differs from its shadow copy, so
+ * signals which do not change cost a single comparison per cycle. The state
+ * of the watches is reset in `Reset` in constant time, the assertion state
+ * of a watch is only valid if it was set in the current epoch.
+ */
+class AbortWatchList {
+ public:
+  static const size_t kNone = static_cast<size_t>(-1);
+
+  /**
+   * Add a signal of any Verilator type (CData, SData, IData, QData, VlWide or
+   * WData arrays).
+   *
+   * After the condition is met, the stop is requested after `delay` cycles.
+   */
+  template <typename T>
+  size_t Add(const char *name, T *signal, const AbortPredicate &predicate,
+             unsigned int delay = 0) {
+    return Add(name, static_cast<const void *>(signal), sizeof(T), predicate,
+               delay);
+  }
+  size_t Add(const char *name, const void *signal, size_t bytes,
+             const AbortPredicate &predicate, unsigned int delay);
+
+  /**
+   * Clear the assertion state of all watches and resynchronize the shadow
+   * copies with the next call to `Check`.
+   */
+  void Reset();
+
+  /**
+   * Evaluate the watches and count down the delays of asserted watches.
+   *
+   * `asserted` is called with the index of each newly asserted watch. The
+   * index of a watch whose delay expired is returned, otherwise `kNone`.
+   */
+  template <typename F>
+  size_t Check(F asserted);
+
+  /**
+   * Evaluate the watches without changing their assertion state.
+   *
+   * `met` is called with the index of each watch whose signal changed and
+   * now meets its condition. Used for conditions which can occur several
+   * times, e.g. injection triggers.
+   */
+  template <typename F>
+  void Scan(F met);
+
+  const std::string &Name(size_t index) const { return watches_[index].name; }
+  size_t Size() const { return watches_.size(); }
+
+ private:
+  struct Watch {
+    std::string name;
+    const void *signal;
+    size_t bytes;
+    size_t words;
+    // Position in `shadow_`
+    size_t offset;
+    AbortPredicate predicate;
+    unsigned int delay;
+  };
+
+  std::vector<struct Watch> watches_;
+  std::vector<EData> shadow_;
+  std::vector<EData> scratch_;
+  // Epoch in which each watch was asserted and the delay counters of
+  // asserted watches
+  std::vector<uint32_t> asserted_epoch_;
+  std::vector<unsigned int> delay_count_;
+  uint32_t epoch_ = 1;
+  // Indices of asserted watches
+  std::vector<size_t> active_;
+  bool synchronized_ = false;
+
+  bool IsAsserted(size_t i) const {
+    return asserted_epoch_[i] == epoch_;
+  }
+  bool Update(size_t i, bool force);
+};
+
+template <typename F>
+void AbortWatchList::Scan(F met) {
+  const bool force = !synchronized_;
+  synchronized_ = true;
+  for (size_t i = 0; i < watches_.size(); ++i) {
+    if (Update(i, force)) {
+      met(i);
+    }
+  }
+}
+
+template <typename F>
+size_t AbortWatchList::Check(F asserted) {
+  Scan([this, &asserted](size_t i) {
+    if (!IsAsserted(i)) {
+      asserted_epoch_[i] = epoch_;
+      delay_count_[i] = watches_[i].delay;
+      active_.push_back(i);
+      asserted(i);
+    }
+  });
+  // After a signal is asserted, wait for 'delay' cycles before signalling the
+  // stop request
+  for (size_t i : active_) {
+    if (delay_count_[i] > 0) {
+      delay_count_[i]--;
+    } else {
+      return i;
+    }
+  }
+  return kNone;
+}
+
+#endif  // ABORT_WATCH_H_
@@ -0,0 +1,220 @@
+#ifndef BOUNDARY_REPLAY_H_
+#define BOUNDARY_REPLAY_H_
+
+#include <verilated.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "checkpoint_ladder.h"
+#include "fault_injection.h"
+#include "fault_space.h"
+
+/**
+ * Simulate faults inside a module with a model of only that module.
+ *
+ * During a golden run of the full design the inputs and outputs of one
+ * instance of the module are recorded each cycle, together with snapshots of
+ * the full design. A faulty run then simulates the model of the module alone
+ * (`Sub`, verilated with the module as top-level) driven by the recorded
+ * inputs. Only if its outputs differ from the recording, the fault can affect
+ * the rest of the design: the full design (`Full`) is restored from the last
+ * snapshot before the fault and simulated with the fault. Both models must be
+ * verilated with `--savable`.
+ *
+ * Faults are given in the coordinates of the fault bus of the module. The
+ * bits of the instance start at `offset` in the fault bus of the full design.
+ *
+ * The harness `H` provides:
+ *   void ResetFull(Full &full, VerilatedContext &context);
+ *   void StepFull(Full &full, VerilatedContext &context);
+ *     Drive the full design into the state of cycle 0 and simulate one cycle.
+ *   void CaptureBoundary(Full &full, EData *inputs, EData *outputs);
+ *     Copy the input and output ports of the instance.
+ *   void ResetSub(Sub &sub, VerilatedContext &context);
+ *   void StepSub(Sub &sub, VerilatedContext &context, const EData *before,
+ *                const EData *after);
+ *     Simulate one cycle with the inputs `before` the clock edge and apply
+ *     the inputs `after` it.
+ *   void SubOutputs(Sub &sub, EData *outputs);
+ *   void SetSubFault(Sub &sub, uint64_t spatial, bool active);
+ *     Drive a bit of the fault bus of the module, see `SetFaultBit`.
+ *   void RunFull(Full &full, VerilatedContext &context, FaultInjection &fi);
+ *     Continue the full design until the end of the run, injecting with `fi`.
+ */
+template <typename Full, typename Sub, typename H>
+class BoundaryReplay {
+ public:
+  struct Result {
+    FaultOutcome outcome;
+    // The outputs of the module diverged and the full design was simulated
+    bool escalated;
+    // First cycle in which the outputs differed from the recording, 0 if not
+    uint64_t divergence;
+  };
+
+  /**
+   * The boundary of the instance consists of `input_words` and
+   * `output_words` 32-bit words. Snapshots are taken every `interval` cycles.
+   */
+  BoundaryReplay(H &harness, Full *full, VerilatedContext *full_context,
+                 Sub *sub, VerilatedContext *sub_context, uint64_t offset,
+                 size_t input_words, size_t output_words, uint64_t interval);
+
+  /**
+   * Run the golden simulation for `cycles` cycles and record the boundary.
+   *
+   * Afterwards the module model is replayed once without a fault. Returns
+   * false if its outputs differ from the recording, e.g. because the
+   * boundary is incomplete; all faults are then simulated with the full
+   * design.
+   */
+  bool Record(uint64_t cycles);
+
+  /**
+   * Simulate a fault of the module.
+   *
+   * `fi` is only used if the run escalates to the full design. It is
+   * configured with the fault translated to the fault bus of the full design.
+   */
+  struct Result Run(const struct Fault &f, FaultInjection &fi);
+
+  void SetFaultDuration(unsigned int length) {
+    fault_length_ = length ? length : 1;
+  }
+
+  /**
+   * Number of runs and the number of runs which escalated.
+   */
+  uint64_t Runs() const { return runs_; }
+  uint64_t Escalations() const { return escalations_; }
+
+ private:
+  H &harness_;
+  Full *full_;
+  VerilatedContext *full_context_;
+  Sub *sub_;
+  VerilatedContext *sub_context_;
+  const uint64_t offset_;
+  const size_t input_words_;
+  const size_t output_words_;
+  unsigned int fault_length_ = 1;
+  CheckpointLadder<Full> full_ladder_;
+  CheckpointLadder<Sub> sub_ladder_;
+  // Boundary of each cycle, index 0 is the state after the reset
+  std::vector<EData> inputs_;
+  std::vector<EData> outputs_;
+  uint64_t cycles_ = 0;
+  bool exact_ = false;
+  uint64_t runs_ = 0;
+  uint64_t escalations_ = 0;
+  // Outputs of the module in the current cycle
+  std::vector<EData> scratch_;
+
+  const EData *Inputs(uint64_t cycle) const {
+    return &inputs_[cycle * input_words_];
+  }
+  const EData *Outputs(uint64_t cycle) const {
+    return &outputs_[cycle * output_words_];
+  }
+  struct Result Escalate(const struct Fault &f, FaultInjection &fi,
+                         uint64_t divergence);
+};
+
+template <typename Full, typename Sub, typename H>
+BoundaryReplay<Full, Sub, H>::BoundaryReplay(
+    H &harness, Full *full, VerilatedContext *full_context, Sub *sub,
+    VerilatedContext *sub_context, uint64_t offset, size_t input_words,
+    size_t output_words, uint64_t interval)
+    : harness_(harness),
+      full_(full),
+      full_context_(full_context),
+      sub_(sub),
+      sub_context_(sub_context),
+      offset_(offset),
+      input_words_(input_words),
+      output_words_(output_words),
+      full_ladder_(full, full_context, interval),
+      sub_ladder_(sub, sub_context, interval),
+      scratch_(output_words, 0) {}
+
+template <typename Full, typename Sub, typename H>
+bool BoundaryReplay<Full, Sub, H>::Record(uint64_t cycles) {
+  full_ladder_.Clear();
+  sub_ladder_.Clear();
+  inputs_.assign((cycles + 1) * input_words_, 0);
+  outputs_.assign((cycles + 1) * output_words_, 0);
+  cycles_ = cycles;
+
+  harness_.ResetFull(*full_, *full_context_);
+  harness_.CaptureBoundary(*full_, &inputs_[0], &outputs_[0]);
+  full_ladder_.Capture(0);
+  for (uint64_t c = 1; c <= cycles_; ++c) {
+    harness_.StepFull(*full_, *full_context_);
+    harness_.CaptureBoundary(*full_, &inputs_[c * input_words_],
+                             &outputs_[c * output_words_]);
+    full_ladder_.Capture(c);
+  }
+
+  // The replay of the module alone must reproduce the recorded outputs
+  exact_ = true;
+  harness_.ResetSub(*sub_, *sub_context_);
+  sub_ladder_.Capture(0);
+  for (uint64_t c = 1; c <= cycles_ && exact_; ++c) {
+    harness_.StepSub(*sub_, *sub_context_, Inputs(c - 1), Inputs(c));
+    harness_.SubOutputs(*sub_, scratch_.data());
+    exact_ = std::memcmp(scratch_.data(), Outputs(c),
+                         output_words_ * sizeof(EData)) == 0;
+    sub_ladder_.Capture(c);
+  }
+  return exact_;
+}
+
+template <typename Full, typename Sub, typename H>
+struct BoundaryReplay<Full, Sub, H>::Result BoundaryReplay<Full, Sub, H>::Run(
+    const struct Fault &f, FaultInjection &fi) {
+  runs_++;
+  uint64_t cycle;
+  if (!exact_ ||
+      !sub_ladder_.Restore(f.temporal ? f.temporal - 1 : 0, cycle)) {
+    return Escalate(f, fi, 0);
+  }
+  // Same timing as `FaultInjection::UpdateInsert`
+  unsigned int remaining = 0;
+  bool injected = false;
+  for (uint64_t c = cycle + 1; c <= cycles_; ++c) {
+    if (!injected && c >= f.temporal) {
+      harness_.SetSubFault(*sub_, f.spatial, true);
+      injected = true;
+      remaining = fault_length_;
+    } else if (remaining && --remaining == 0) {
+      harness_.SetSubFault(*sub_, f.spatial, false);
+    }
+    harness_.StepSub(*sub_, *sub_context_, Inputs(c - 1), Inputs(c));
+    harness_.SubOutputs(*sub_, scratch_.data());
+    if (std::memcmp(scratch_.data(), Outputs(c),
+                    output_words_ * sizeof(EData)) != 0) {
+      return Escalate(f, fi, c);
+    }
+  }
+  // The fault did not leave the module within the recording
+  return Result{injected ? FaultOutcome::kNoEffect : FaultOutcome::kNotInjected,
+                false, 0};
+}
+
+template <typename Full, typename Sub, typename H>
+struct BoundaryReplay<Full, Sub, H>::Result
+BoundaryReplay<Full, Sub, H>::Escalate(const struct Fault &f,
+                                       FaultInjection &fi,
+                                       uint64_t divergence) {
+  escalations_++;
+  fi.UpdateSpace(Fault{f.temporal, offset_ + f.spatial});
+  if (!full_ladder_.Restore(fi)) {
+    harness_.ResetFull(*full_, *full_context_);
+  }
+  harness_.RunFull(*full_, *full_context_, fi);
+  return Result{fi.Outcome(), true, divergence};
+}
+
+#endif  // BOUNDARY_REPLAY_H_
@@ -0,0 +1,213 @@
+#include "campaign_daemon.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+bool SendAll(int fd, const std::string &s) {
+  size_t sent = 0;
+  while (sent < s.size()) {
+    ssize_t n = send(fd, s.data() + sent, s.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
+
+}  // namespace
+
+CampaignDaemon::CampaignDaemon(FaultInjection &fi, RunFunction run)
+    : fi_(fi), run_(run) {}
+
+CampaignDaemon::~CampaignDaemon() { Close(); }
+
+void CampaignDaemon::Close() {
+  if (listen_fd_ >= 0) {
+    close(listen_fd_);
+    unlink(path_.c_str());
+  }
+  listen_fd_ = -1;
+}
+
+bool CampaignDaemon::Serve(const std::string &path) {
+  struct sockaddr_un addr;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "ERROR: Socket path too long: " << path << std::endl;
+    return false;
+  }
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+  Close();
+  listen_fd_ = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd_ < 0) {
+    std::cerr << "ERROR: Can not create socket: " << std::strerror(errno)
+              << std::endl;
+    return false;
+  }
+  unlink(path.c_str());
+  path_ = path;
+  if (bind(listen_fd_, reinterpret_cast<struct sockaddr *>(&addr),
+           sizeof(addr)) != 0 ||
+      listen(listen_fd_, 8) != 0) {
+    std::cerr << "ERROR: Can not listen on " << path << ": "
+              << std::strerror(errno) << std::endl;
+    Close();
+    return false;
+  }
+  std::cout << "Waiting for fault jobs on " << path << std::endl;
+
+  shutdown_ = false;
+  while (!shutdown_) {
+    int fd = accept(listen_fd_, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    ServeClient(fd);
+    close(fd);
+  }
+  Close();
+  return true;
+}
+
+void CampaignDaemon::ServeClient(int fd) {
+  std::string pending;
+  char buffer[4096];
+  while (!shutdown_) {
+    ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) {
+      return;
+    }
+    pending.append(buffer, n);
+    size_t end;
+    while ((end = pending.find('\n')) != std::string::npos) {
+      std::string line = pending.substr(0, end);
+      pending.erase(0, end + 1);
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      if (!Execute(fd, line) || shutdown_) {
+        return;
+      }
+    }
+  }
+}
+
+bool CampaignDaemon::Execute(int fd, const std::string &line) {
+  std::istringstream iss(line);
+  std::string command;
+  iss >> command;
+  if (command.empty()) {
+    return true;
+  }
+  if (command == "run") {
+    struct Fault f;
+    std::string option;
+    if (!(iss >> f.temporal >> f.spatial)) {
+      return SendAll(fd, "error usage: run <cycle> <bit> [log]\n");
+    }
+    if (!fi_.GetFullSpace().Contains(f)) {
+      return SendAll(fd, "error fault outside of the fault space\n");
+    }
+    iss >> option;
+    fi_.UpdateSpace(f);
+    RunFault(fd, option == "log");
+  } else if (command == "batch") {
+    uint64_t first, count;
+    if (!(iss >> first >> count)) {
+      return SendAll(fd, "error usage: batch <first> <count>\n");
+    }
+    // Also rejects a `first + count` which overflows
+    const uint64_t size = fi_.GetFullSpace().Size();
+    if (count > size || first > size - count) {
+      return SendAll(fd, "error batch outside of the fault space\n");
+    }
+    for (uint64_t i = first; i < first + count; ++i) {
+      fi_.UpdateSpace(i);
+      RunFault(fd, false);
+    }
+  } else if (command == "lookup") {
+    return Lookup(fd, iss);
+  } else if (command == "duration") {
+    unsigned int cycles;
+    if (!(iss >> cycles) || !cycles) {
+      return SendAll(fd, "error usage: duration <cycles>\n");
+    }
+    fi_.SetFaultDuration(cycles);
+  } else if (command == "shutdown") {
+    shutdown_ = true;
+  } else if (command != "ping") {
+    return SendAll(fd, "error unknown command " + command + "\n");
+  }
+  return SendAll(fd, "ok\n");
+}
+
+void CampaignDaemon::RunFault(int fd, bool log) {
+  run_(fi_);
+  runs_++;
+  struct Fault f = fi_.GetFaultSpace();
+  std::ostringstream os;
+  os << "result " << fi_.FaultId() << " " << f.temporal << " " << f.spatial
+     << " " << FaultOutcomeName(fi_.Outcome()) << " " << fi_.Cycle() << "\n";
+  if (log) {
+    std::istringstream events;
+    std::ostringstream text;
+    text << fi_;
+    events.str(text.str());
+    std::string l;
+    while (std::getline(events, l)) {
+      os << "# " << l << "\n";
+    }
+  }
+  // A closed connection is noticed when reading the next request
+  SendAll(fd, os.str());
+}
+
+bool CampaignDaemon::Lookup(int fd, std::istringstream &iss) {
+  uint64_t cycle;
+  std::string kind;
+  uint32_t monitor;
+  if (!(iss >> cycle >> kind >> monitor) ||
+      (kind != "abort" && kind != "match")) {
+    return SendAll(
+        fd, "error usage: lookup <cycle> abort|match <monitor> [value]\n");
+  }
+  // Values of data matches are usually given in hex
+  uint64_t value = 0;
+  std::string v;
+  if (iss >> v) {
+    char *end;
+    value = std::strtoull(v.c_str(), &end, 0);
+    if (*end) {
+      return SendAll(fd, "error invalid value " + v + "\n");
+    }
+  }
+  if (dictionary_ == nullptr) {
+    return SendAll(fd, "error no fault dictionary\n");
+  }
+  dictionary_->Refresh();
+  const FaultSpace space = fi_.GetFullSpace();
+  std::ostringstream os;
+  for (uint64_t id : dictionary_->Lookup(FailureSignature::FromObservation(
+           cycle,
+           kind == "abort" ? EventKind::kAbortDetected : EventKind::kDataMatch,
+           value, monitor))) {
+    struct Fault f = space.At(id);
+    os << "fault " << id << " " << f.temporal << " " << f.spatial << "\n";
+  }
+  os << "ok\n";
+  return SendAll(fd, os.str());
+}
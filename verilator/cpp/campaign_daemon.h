@@ -0,0 +1,88 @@
+#ifndef CAMPAIGN_DAEMON_H_
+#define CAMPAIGN_DAEMON_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <sstream>
+#include <string>
+
+#include "fault_dictionary.h"
+#include "fault_injection.h"
+
+/**
+ * Serve fault injection runs of a loaded model on a local Unix socket.
+ *
+ * The process is started once, so argument parsing, model construction and
+ * the reset prefix (e.g. with a `CheckpointLadder`) are not repeated for each
+ * query. Clients are served one after the other with a line based protocol:
+ *
+ *   run <cycle> <bit> [log]   Run a single fault of the configured fault
+ *                             space, optionally with the log
+ *   batch <first> <count>     Run iterations of the configured fault space
+ *   duration <cycles>         Set the duration of the faults
+ *   lookup <cycle> abort|match <monitor> [value]
+ *                             Find the faults of an observed failure in the
+ *                             fault dictionary, see `SetDictionary`
+ *   ping                      Check that the daemon is alive
+ *   shutdown                  Stop the daemon
+ *
+ * Each run is answered with a line
+ *
+ *   result <fault id> <cycle> <bit> <outcome> <simulated cycles>
+ *
+ * as soon as it finished, log lines start with `#`. Each fault of a lookup is
+ * answered with a line
+ *
+ *   fault <fault id> <cycle> <bit>
+ *
+ * Every request ends with a line `ok` or `error <message>`.
+ */
+class CampaignDaemon {
+ public:
+  /**
+   * Simulate the fault which is configured in `fi`.
+   */
+  typedef std::function<void(FaultInjection &fi)> RunFunction;
+
+  CampaignDaemon(FaultInjection &fi, RunFunction run);
+  ~CampaignDaemon();
+
+  /**
+   * Listen on `path` and serve requests until a shutdown is requested.
+   *
+   * An existing socket file at `path` is replaced. Returns false if the
+   * socket could not be created.
+   */
+  bool Serve(const std::string &path);
+
+  /**
+   * Answer `lookup` requests from `dictionary`, which is refreshed before
+   * each lookup.
+   */
+  void SetDictionary(FaultDictionary *dictionary) { dictionary_ = dictionary; }
+
+  /**
+   * Number of runs since the start.
+   */
+  uint64_t Runs() const { return runs_; }
+
+ private:
+  FaultInjection &fi_;
+  RunFunction run_;
+  FaultDictionary *dictionary_ = nullptr;
+  int listen_fd_ = -1;
+  std::string path_;
+  // Read by other threads, see `Runs`
+  std::atomic<uint64_t> runs_{0};
+  bool shutdown_ = false;
+
+  void Close();
+  void ServeClient(int fd);
+  // Execute a single request, returns false if the client should be closed
+  bool Execute(int fd, const std::string &line);
+  void RunFault(int fd, bool log);
+  bool Lookup(int fd, std::istringstream &iss);
+};
+
+#endif  // CAMPAIGN_DAEMON_H_
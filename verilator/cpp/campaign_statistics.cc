@@ -0,0 +1,204 @@
+#include "campaign_statistics.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <ostream>
+#include <sstream>
+
+namespace {
+
+// Print the outcome counters of one row followed by the sensitivity, the
+// share of injected faults which had an observable effect.
+void WriteCounts(std::ostream &os, const unsigned long *counts,
+                 unsigned int num_outcomes) {
+  unsigned long injected = 0;
+  unsigned long effective = 0;
+  for (unsigned int i = 0; i < num_outcomes; ++i) {
+    os << "," << counts[i];
+    if (i != static_cast<unsigned int>(FaultOutcome::kNotInjected)) {
+      injected += counts[i];
+    }
+    if (i == static_cast<unsigned int>(FaultOutcome::kAbort) ||
+        i == static_cast<unsigned int>(FaultOutcome::kDataMatch)) {
+      effective += counts[i];
+    }
+  }
+  os << ",";
+  if (injected) {
+    os << static_cast<double>(effective) / injected;
+  } else {
+    os << 0;
+  }
+  os << "\n";
+}
+
+void WriteHeader(std::ostream &os, const char *columns,
+                 unsigned int num_outcomes) {
+  os << columns;
+  for (unsigned int i = 0; i < num_outcomes; ++i) {
+    os << "," << FaultOutcomeName(static_cast<FaultOutcome>(i));
+  }
+  os << ",sensitivity\n";
+}
+
+// Read the outcome counters of `rows` rows, each starting with `skip` other
+// columns. The sensitivity is derived and not read.
+bool ReadCounts(const std::string &filename, unsigned int skip, size_t rows,
+                unsigned long *counts, unsigned int num_outcomes) {
+  std::ifstream is(filename);
+  std::string line;
+  // Header
+  if (!std::getline(is, line)) {
+    return false;
+  }
+  for (size_t r = 0; r < rows; ++r) {
+    if (!std::getline(is, line)) {
+      return false;
+    }
+    std::istringstream iss(line);
+    std::string cell;
+    for (unsigned int i = 0; i < skip; ++i) {
+      std::getline(iss, cell, ',');
+    }
+    for (unsigned int i = 0; i < num_outcomes; ++i) {
+      char *end;
+      if (!std::getline(iss, cell, ',') || cell.empty()) {
+        return false;
+      }
+      counts[r * num_outcomes + i] = std::strtoul(cell.c_str(), &end, 10);
+      if (*end) {
+        return false;
+      }
+    }
+  }
+  // No additional rows
+  return !std::getline(is, line);
+}
+
+}  // namespace
+
+CampaignStatistics::CampaignStatistics(unsigned int fi_signal_len,
+                                       uint64_t temporal_start,
+                                       uint64_t bucket_width,
+                                       unsigned int num_buckets)
+    : num_bits_(fi_signal_len),
+      temporal_start_(temporal_start),
+      bucket_width_(bucket_width ? bucket_width : 1),
+      num_buckets_(num_buckets ? num_buckets : 1),
+      runs_(0),
+      checkpoint_interval_(0),
+      bit_counts_(fi_signal_len * kNumOutcomes, 0),
+      bucket_counts_((num_buckets ? num_buckets : 1) * kNumOutcomes, 0) {}
+
+void CampaignStatistics::AddModule(const char *name, unsigned int offset,
+                                   unsigned int width) {
+  modules_.push_back(ModuleRange{name, offset, width});
+  module_counts_.resize(modules_.size() * kNumOutcomes, 0);
+}
+
+unsigned int CampaignStatistics::Bucket(uint64_t temporal) const {
+  if (temporal < temporal_start_) {
+    return 0;
+  }
+  uint64_t b = (temporal - temporal_start_) / bucket_width_;
+  return b < num_buckets_ ? static_cast<unsigned int>(b) : num_buckets_ - 1;
+}
+
+void CampaignStatistics::Record(const struct Fault &f, FaultOutcome outcome) {
+  const unsigned int o = static_cast<unsigned int>(outcome);
+  if (f.spatial < num_bits_) {
+    bit_counts_[f.spatial * kNumOutcomes + o]++;
+  }
+  bucket_counts_[Bucket(f.temporal) * kNumOutcomes + o]++;
+  for (size_t m = 0; m < modules_.size(); ++m) {
+    if (f.spatial >= modules_[m].offset &&
+        f.spatial - modules_[m].offset < modules_[m].width) {
+      module_counts_[m * kNumOutcomes + o]++;
+    }
+  }
+  runs_++;
+  if (checkpoint_interval_ && runs_ % checkpoint_interval_ == 0) {
+    WriteCsv(checkpoint_prefix_);
+  }
+}
+
+void CampaignStatistics::Record(FaultInjection &fi) {
+  Record(fi.GetFaultSpace(), fi.Outcome());
+}
+
+void CampaignStatistics::SetCheckpoint(const std::string &prefix,
+                                       unsigned long interval) {
+  checkpoint_prefix_ = prefix;
+  checkpoint_interval_ = interval;
+}
+
+bool CampaignStatistics::WriteCsv(const std::string &prefix) const {
+  bool ok = WriteBits(prefix + "_bits.csv");
+  ok &= WriteCycles(prefix + "_cycles.csv");
+  ok &= WriteModules(prefix + "_modules.csv");
+  return ok;
+}
+
+bool CampaignStatistics::WriteBits(const std::string &filename) const {
+  std::ofstream os(filename);
+  if (!os) {
+    return false;
+  }
+  WriteHeader(os, "bit", kNumOutcomes);
+  for (unsigned int b = 0; b < num_bits_; ++b) {
+    os << b;
+    WriteCounts(os, &bit_counts_[b * kNumOutcomes], kNumOutcomes);
+  }
+  return os.good();
+}
+
+bool CampaignStatistics::WriteCycles(const std::string &filename) const {
+  std::ofstream os(filename);
+  if (!os) {
+    return false;
+  }
+  WriteHeader(os, "cycle_start,cycle_end", kNumOutcomes);
+  for (unsigned int b = 0; b < num_buckets_; ++b) {
+    os << temporal_start_ + b * bucket_width_ << ","
+       << temporal_start_ + (b + 1) * bucket_width_ - 1;
+    WriteCounts(os, &bucket_counts_[b * kNumOutcomes], kNumOutcomes);
+  }
+  return os.good();
+}
+
+bool CampaignStatistics::WriteModules(const std::string &filename) const {
+  std::ofstream os(filename);
+  if (!os) {
+    return false;
+  }
+  WriteHeader(os, "module,offset,width", kNumOutcomes);
+  for (size_t m = 0; m < modules_.size(); ++m) {
+    os << modules_[m].name << "," << modules_[m].offset << ","
+       << modules_[m].width;
+    WriteCounts(os, &module_counts_[m * kNumOutcomes], kNumOutcomes);
+  }
+  return os.good();
+}
+
+bool CampaignStatistics::ReadCsv(const std::string &prefix) {
+  std::vector<unsigned long> bits(bit_counts_.size());
+  std::vector<unsigned long> buckets(bucket_counts_.size());
+  std::vector<unsigned long> modules(module_counts_.size());
+  if (!ReadCounts(prefix + "_bits.csv", 1, num_bits_, bits.data(),
+                  kNumOutcomes) ||
+      !ReadCounts(prefix + "_cycles.csv", 2, num_buckets_, buckets.data(),
+                  kNumOutcomes) ||
+      !ReadCounts(prefix + "_modules.csv", 3, modules_.size(), modules.data(),
+                  kNumOutcomes)) {
+    return false;
+  }
+  bit_counts_.swap(bits);
+  bucket_counts_.swap(buckets);
+  module_counts_.swap(modules);
+  // Each run is counted in exactly one bucket
+  runs_ = 0;
+  for (unsigned long c : bucket_counts_) {
+    runs_ += c;
+  }
+  return true;
+}
@@ -0,0 +1,97 @@
+#ifndef CAMPAIGN_STATISTICS_H_
+#define CAMPAIGN_STATISTICS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "fault_injection.h"
+
+/**
+ * Aggregate the outcome of fault injection runs into fixed-size counters.
+ *
+ * Each finished run is added with `Record`. Outcomes are counted per bit of
+ * the fault injection bus, per temporal bucket and per registered module
+ * range. The memory used is determined at construction and does not grow with
+ * the number of runs.
+ */
+class CampaignStatistics {
+ public:
+  /**
+   * Create counters for a fault injection bus of `fi_signal_len` bits.
+   *
+   * The temporal space is split into `num_buckets` buckets of `bucket_width`
+   * cycles each, beginning at `temporal_start`. Faults before the first or
+   * after the last bucket are counted in the first or last bucket.
+   */
+  CampaignStatistics(unsigned int fi_signal_len, uint64_t temporal_start,
+                     uint64_t bucket_width, unsigned int num_buckets);
+
+  /**
+   * Register a module occupying the bits [offset, offset + width) of the
+   * fault injection bus. Ranges may overlap, e.g. for nested modules.
+   */
+  void AddModule(const char *name, unsigned int offset, unsigned int width);
+
+  /**
+   * Add the result of a finished run.
+   */
+  void Record(const struct Fault &f, FaultOutcome outcome);
+  void Record(FaultInjection &fi);
+
+  /**
+   * Write the CSV files every `interval` recorded runs.
+   *
+   * A value of 0 disables the checkpoints.
+   */
+  void SetCheckpoint(const std::string &prefix, unsigned long interval);
+
+  /**
+   * Write the counters as `<prefix>_bits.csv`, `<prefix>_cycles.csv` and
+   * `<prefix>_modules.csv`.
+   */
+  bool WriteCsv(const std::string &prefix) const;
+
+  /**
+   * Continue with the counters of files written by `WriteCsv`, e.g. the
+   * checkpoint of an interrupted campaign.
+   *
+   * The bits, buckets and modules must be configured as when the files were
+   * written. Returns false and keeps the counters if a file does not match.
+   */
+  bool ReadCsv(const std::string &prefix);
+
+  /**
+   * Get the number of recorded runs.
+   */
+  unsigned long Runs() const { return runs_; }
+
+ private:
+  static const unsigned int kNumOutcomes =
+      static_cast<unsigned int>(FaultOutcome::kNumOutcomes);
+
+  struct ModuleRange {
+    std::string name;
+    unsigned int offset;
+    unsigned int width;
+  };
+
+  const unsigned int num_bits_;
+  const uint64_t temporal_start_;
+  const uint64_t bucket_width_;
+  const unsigned int num_buckets_;
+  unsigned long runs_;
+  unsigned long checkpoint_interval_;
+  std::string checkpoint_prefix_;
+  std::vector<unsigned long> bit_counts_;
+  std::vector<unsigned long> bucket_counts_;
+  std::vector<unsigned long> module_counts_;
+  std::vector<struct ModuleRange> modules_;
+
+  unsigned int Bucket(uint64_t temporal) const;
+  bool WriteBits(const std::string &filename) const;
+  bool WriteCycles(const std::string &filename) const;
+  bool WriteModules(const std::string &filename) const;
+};
+
+#endif  // CAMPAIGN_STATISTICS_H_
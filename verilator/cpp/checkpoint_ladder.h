@@ -0,0 +1,286 @@
+#ifndef CHECKPOINT_LADDER_H_
+#define CHECKPOINT_LADDER_H_
+
+#include <verilated.h>
+#include <verilated_save.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "fault_injection.h"
+
+/**
+ * Serialize a Verilator model into a byte vector instead of a file.
+ */
+class MemorySerialize : public VerilatedSerialize {
+ public:
+  explicit MemorySerialize(std::vector<uint8_t> *out) : out_(out) {
+    m_isOpen = true;
+  }
+  // The base class destructor can not call the overridden `flush`
+  ~MemorySerialize() override { flush(); }
+  void flush() override {
+    out_->insert(out_->end(), m_bufp, m_cp);
+    m_cp = m_bufp;
+  }
+
+ private:
+  std::vector<uint8_t> *out_;
+};
+
+/**
+ * Restore a Verilator model from a byte buffer instead of a file.
+ */
+class MemoryDeserialize : public VerilatedDeserialize {
+ public:
+  MemoryDeserialize(const uint8_t *data, size_t size)
+      : data_(data), size_(size), pos_(0) {
+    // Verilator leaves the end of the buffer unset until a file is opened
+    m_cp = m_bufp;
+    m_endp = m_bufp;
+    m_isOpen = true;
+  }
+  void fill() override {
+    // Move the not yet consumed bytes to the start of the buffer
+    size_t remaining = m_endp - m_cp;
+    if (remaining) {
+      std::memmove(m_bufp, m_cp, remaining);
+    }
+    m_cp = m_bufp;
+    m_endp = m_bufp + remaining;
+    size_t n = std::min(bufferSize() - remaining, size_ - pos_);
+    std::memcpy(m_endp, data_ + pos_, n);
+    m_endp += n;
+    pos_ += n;
+  }
+
+ private:
+  const uint8_t *data_;
+  size_t size_;
+  size_t pos_;
+};
+
+/**
+ * In-memory snapshots of a model taken during a golden run.
+ *
+ * The model must be verilated with `--savable`. During the golden run
+ * `Capture` is called each cycle and stores the model state every `interval`
+ * cycles. Afterwards `Restore` returns the model to the closest snapshot
+ * before a fault, so only the cycles between the snapshot and the end of the
+ * run need to be simulated.
+ *
+ * If `keyframe_interval` is larger than one, only every n-th snapshot is
+ * stored completely. All other snapshots are stored as run-length encoded
+ * difference to the last complete one, which is small as most of the model
+ * state does not change between snapshots.
+ */
+template <typename M>
+class CheckpointLadder {
+ public:
+  CheckpointLadder(M *model, VerilatedContext *context, uint64_t interval,
+                   unsigned int keyframe_interval = 1);
+
+  /**
+   * Store a snapshot if `cycle` is a multiple of the interval.
+   *
+   * `cycle` is the number of cycles already counted by `FaultInjection`, i.e.
+   * the snapshot must be taken before `UpdateInsert` is called in that cycle.
+   */
+  bool Capture(uint64_t cycle);
+
+  /**
+   * Restore the last snapshot taken at or before `temporal`.
+   *
+   * The cycle of the snapshot is returned in `cycle`.
+   */
+  bool Restore(uint64_t temporal, uint64_t &cycle);
+
+  /**
+   * Restore the last snapshot before the active fault of `fi` and continue
+   * the cycle count of `fi` from there.
+   */
+  bool Restore(FaultInjection &fi);
+
+  /**
+   * Remove all snapshots.
+   */
+  void Clear();
+
+  size_t Count() const { return snapshots_.size(); }
+  size_t MemoryUsage() const { return arena_.size(); }
+
+ private:
+  struct Snapshot {
+    uint64_t cycle;
+    uint64_t time;
+    size_t offset;
+    size_t size;
+    // Index of the complete snapshot this one is relative to
+    size_t keyframe;
+  };
+
+  M *model_;
+  VerilatedContext *context_;
+  const uint64_t interval_;
+  const unsigned int keyframe_interval_;
+  std::vector<uint8_t> arena_;
+  std::vector<struct Snapshot> snapshots_;
+  // Scratch buffers, kept to avoid an allocation for each snapshot
+  std::vector<uint8_t> state_;
+  std::vector<uint8_t> keyframe_state_;
+
+  void Encode(const std::vector<uint8_t> &state,
+              const std::vector<uint8_t> &base);
+  void Decode(size_t index, std::vector<uint8_t> &state) const;
+  static void PutVarint(std::vector<uint8_t> &out, size_t value);
+  static size_t GetVarint(const uint8_t *&p);
+};
+
+template <typename M>
+CheckpointLadder<M>::CheckpointLadder(M *model, VerilatedContext *context,
+                                      uint64_t interval,
+                                      unsigned int keyframe_interval)
+    : model_(model),
+      context_(context),
+      interval_(interval ? interval : 1),
+      keyframe_interval_(keyframe_interval ? keyframe_interval : 1) {}
+
+template <typename M>
+bool CheckpointLadder<M>::Capture(uint64_t cycle) {
+  if (cycle % interval_ ||
+      (!snapshots_.empty() && snapshots_.back().cycle >= cycle)) {
+    return false;
+  }
+  state_.clear();
+  {
+    MemorySerialize os(&state_);
+    os << *model_;
+  }
+  struct Snapshot s {
+    cycle, context_->time(), arena_.size(), 0, snapshots_.size()
+  };
+  if (snapshots_.size() % keyframe_interval_ == 0) {
+    arena_.insert(arena_.end(), state_.begin(), state_.end());
+    keyframe_state_.swap(state_);
+  } else {
+    s.keyframe = snapshots_.size() - snapshots_.size() % keyframe_interval_;
+    Encode(state_, keyframe_state_);
+  }
+  s.size = arena_.size() - s.offset;
+  snapshots_.push_back(s);
+  return true;
+}
+
+template <typename M>
+bool CheckpointLadder<M>::Restore(uint64_t temporal, uint64_t &cycle) {
+  // Snapshots are ordered by cycle
+  auto it = std::upper_bound(
+      snapshots_.begin(), snapshots_.end(), temporal,
+      [](uint64_t t, const struct Snapshot &s) { return t < s.cycle; });
+  if (it == snapshots_.begin()) {
+    return false;
+  }
+  --it;
+  Decode(it - snapshots_.begin(), state_);
+  MemoryDeserialize os(state_.data(), state_.size());
+  os >> *model_;
+  context_->time(it->time);
+  cycle = it->cycle;
+  return true;
+}
+
+template <typename M>
+bool CheckpointLadder<M>::Restore(FaultInjection &fi) {
+  uint64_t cycle;
+  // The fault is inserted when the cycle count reaches the temporal value, so
+  // the snapshot must be taken before the count is incremented to it.
+  uint64_t temporal = fi.InjectionCycle();
+  if (!Restore(temporal ? temporal - 1 : 0, cycle)) {
+    return false;
+  }
+  fi.SetCycle(cycle);
+  return true;
+}
+
+template <typename M>
+void CheckpointLadder<M>::Clear() {
+  arena_.clear();
+  snapshots_.clear();
+  keyframe_state_.clear();
+}
+
+template <typename M>
+void CheckpointLadder<M>::PutVarint(std::vector<uint8_t> &out, size_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value) | 0x80);
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+template <typename M>
+size_t CheckpointLadder<M>::GetVarint(const uint8_t *&p) {
+  size_t value = 0;
+  unsigned int shift = 0;
+  while (*p & 0x80) {
+    value |= static_cast<size_t>(*p++ & 0x7f) << shift;
+    shift += 7;
+  }
+  value |= static_cast<size_t>(*p++) << shift;
+  return value;
+}
+
+// The difference is stored as a sequence of (unchanged bytes, changed bytes,
+// XOR of the changed bytes).
+template <typename M>
+void CheckpointLadder<M>::Encode(const std::vector<uint8_t> &state,
+                                 const std::vector<uint8_t> &base) {
+  PutVarint(arena_, state.size());
+  size_t i = 0;
+  while (i < state.size()) {
+    size_t start = i;
+    while (i < state.size() && i < base.size() && state[i] == base[i]) {
+      i++;
+    }
+    size_t same = i - start;
+    start = i;
+    while (i < state.size() && (i >= base.size() || state[i] != base[i])) {
+      i++;
+    }
+    PutVarint(arena_, same);
+    PutVarint(arena_, i - start);
+    for (size_t j = start; j < i; ++j) {
+      arena_.push_back(state[j] ^ (j < base.size() ? base[j] : 0));
+    }
+  }
+}
+
+template <typename M>
+void CheckpointLadder<M>::Decode(size_t index,
+                                 std::vector<uint8_t> &state) const {
+  const struct Snapshot &s = snapshots_[index];
+  const struct Snapshot &key = snapshots_[s.keyframe];
+  const uint8_t *base = &arena_[key.offset];
+  if (s.keyframe == index) {
+    state.assign(base, base + key.size);
+    return;
+  }
+  const uint8_t *p = &arena_[s.offset];
+  size_t size = GetVarint(p);
+  state.resize(size);
+  size_t i = 0;
+  while (i < size) {
+    size_t same = GetVarint(p);
+    size_t changed = GetVarint(p);
+    for (size_t j = 0; j < same; ++j, ++i) {
+      state[i] = base[i];
+    }
+    for (size_t j = 0; j < changed; ++j, ++i) {
+      state[i] = *p++ ^ (i < key.size ? base[i] : 0);
+    }
+  }
+}
+
+#endif  // CHECKPOINT_LADDER_H_
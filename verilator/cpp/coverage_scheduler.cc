@@ -0,0 +1,253 @@
+#include "coverage_scheduler.h"
+
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+uint64_t Mix(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  return x ^ (x >> 33);
+}
+
+// Bucket of a hit count: 0, 1, 2-3, 4-7, 8-15, ...
+unsigned int CountBucket(uint32_t count) {
+  unsigned int bucket = 0;
+  for (uint32_t c = count; c; c >>= 1) {
+    bucket++;
+  }
+  return bucket;
+}
+
+// Energy of a new corpus entry, a leak of data is preferred
+double InitialEnergy(FaultOutcome outcome, uint64_t new_features) {
+  double energy = 1.0 + new_features;
+  if (outcome == FaultOutcome::kDataMatch) {
+    energy += 4.0;
+  }
+  return energy;
+}
+
+}  // namespace
+
+CoverageMap::CoverageMap(unsigned int bits)
+    : mask_((1ULL << (bits < 1 ? 1 : bits > kMaxBits ? kMaxBits : bits)) - 1),
+      run_(mask_ + 1, 0),
+      total_(mask_ + 1, 0) {
+  touched_.reserve(mask_ + 1);
+}
+
+void CoverageMap::Add(uint64_t feature) {
+  size_t i = Mix(feature) & mask_;
+  if (!run_[i]) {
+    run_[i] = 1;
+    touched_.push_back(i);
+  }
+}
+
+void CoverageMap::Observe(uint64_t value) {
+  // Hash of the transition, the value alone would not distinguish paths
+  Add(Mix(previous_) ^ value);
+  previous_ = value;
+}
+
+void CoverageMap::ObserveCounter(size_t index, uint32_t count) {
+  if (count) {
+    // Separate from the state transitions
+    Add(~(static_cast<uint64_t>(index) << 6 | CountBucket(count)));
+  }
+}
+
+uint64_t CoverageMap::Commit() {
+  uint64_t found = 0;
+  for (size_t i : touched_) {
+    if (!total_[i]) {
+      total_[i] = 1;
+      found++;
+    }
+    run_[i] = 0;
+  }
+  touched_.clear();
+  previous_ = 0;
+  total_count_ += found;
+  return found;
+}
+
+CoverageScheduler::CoverageScheduler(const FaultSpace &space, uint64_t seed)
+    : space_(space), rng_(Mix(seed ^ 0x9e3779b97f4a7c15ULL)) {}
+
+uint64_t CoverageScheduler::Random() {
+  // splitmix64
+  rng_ += 0x9e3779b97f4a7c15ULL;
+  return Mix(rng_);
+}
+
+bool CoverageScheduler::IsSelected(uint64_t index) const {
+  return space_.Unpermute(index) < explore_next_ || neighbours_.count(index);
+}
+
+bool CoverageScheduler::Next(struct Fault &f) {
+  if (selected_ >= space_.Size()) {
+    return false;
+  }
+  const bool explore = corpus_.empty() || static_cast<double>(Random() >> 11) /
+                                                  (1ULL << 53) <
+                                              exploration_;
+  parent_ = kNoParent;
+  if ((explore || !Mutate(f)) && !Explore(f)) {
+    // Only neighbours of the corpus are left
+    if (corpus_.empty() || !Mutate(f)) {
+      return false;
+    }
+  }
+  // Faults of the pseudo-random order are known by their position
+  if (parent_ != kNoParent) {
+    neighbours_.insert(space_.IndexOf(f));
+  }
+  selected_++;
+  last_ = f;
+  return true;
+}
+
+bool CoverageScheduler::Explore(struct Fault &f) {
+  while (explore_next_ < space_.Size()) {
+    uint64_t index = space_.Permute(explore_next_++);
+    // Now covered by the position, no need to store it any longer
+    if (!neighbours_.erase(index)) {
+      f = space_.At(index);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool CoverageScheduler::Mutate(struct Fault &f) {
+  for (unsigned int attempt = 0; attempt < kMutationAttempts; ++attempt) {
+    // Select a corpus entry with a probability proportional to its energy
+    double sum = 0.0;
+    for (size_t i = energy_tree_.size(); i; i -= i & (~i + 1)) {
+      sum += energy_tree_[i - 1];
+    }
+    size_t parent =
+        FindEnergy(static_cast<double>(Random() >> 11) / (1ULL << 53) * sum);
+    const struct Fault &p = corpus_[parent].fault;
+    // Offsets in [-radius, radius], wrapping below 0 leaves the space
+    uint64_t dt = Random() % (2 * temporal_radius_ + 1);
+    uint64_t ds = Random() % (2 * spatial_radius_ + 1);
+    struct Fault n {
+      p.temporal + dt - temporal_radius_, p.spatial + ds - spatial_radius_
+    };
+    if (space_.Contains(n) && !IsSelected(space_.IndexOf(n))) {
+      f = n;
+      parent_ = parent;
+      return true;
+    }
+  }
+  return false;
+}
+
+void CoverageScheduler::Report(const struct Fault &f, FaultOutcome outcome,
+                               uint64_t new_features) {
+  const bool interesting =
+      new_features > 0 || outcome == FaultOutcome::kDataMatch;
+  if (parent_ != kNoParent && f.temporal == last_.temporal &&
+      f.spatial == last_.spatial) {
+    const double energy = corpus_[parent_].energy;
+    double next = interesting ? energy + 1.0 : energy * 0.9;
+    // Keep every entry selectable
+    if (next < 0.01) {
+      next = 0.01;
+    }
+    AddEnergy(parent_, next - energy);
+  }
+  parent_ = kNoParent;
+  if (interesting) {
+    AddToCorpus(CorpusEntry{f, outcome, new_features,
+                            InitialEnergy(outcome, new_features)});
+  }
+}
+
+void CoverageScheduler::AddToCorpus(const struct CorpusEntry &e) {
+  corpus_.push_back(e);
+  // Node i holds the sum of the entries (i - lowbit(i), i], 1-based
+  const size_t i = corpus_.size();
+  double sum = e.energy;
+  for (size_t child = 1; child < (i & (~i + 1)); child <<= 1) {
+    sum += energy_tree_[i - child - 1];
+  }
+  energy_tree_.push_back(sum);
+}
+
+void CoverageScheduler::AddEnergy(size_t entry, double delta) {
+  corpus_[entry].energy += delta;
+  for (size_t i = entry + 1; i <= energy_tree_.size(); i += i & (~i + 1)) {
+    energy_tree_[i - 1] += delta;
+  }
+}
+
+size_t CoverageScheduler::FindEnergy(double pick) const {
+  const size_t n = energy_tree_.size();
+  size_t step = 1;
+  while (step * 2 <= n) {
+    step *= 2;
+  }
+  size_t pos = 0;
+  for (; step; step >>= 1) {
+    if (pos + step <= n && energy_tree_[pos + step - 1] <= pick) {
+      pos += step;
+      pick -= energy_tree_[pos - 1];
+    }
+  }
+  // Rounding can leave a rest after the last entry
+  return pos < n ? pos : n - 1;
+}
+
+bool CoverageScheduler::SaveCorpus(const std::string &filename) const {
+  std::ofstream f(filename, std::ios::trunc);
+  if (!f) {
+    return false;
+  }
+  for (auto &e : corpus_) {
+    f << e.fault.temporal << " " << e.fault.spatial << " "
+      << FaultOutcomeName(e.outcome) << " " << e.new_features << "\n";
+  }
+  return f.good();
+}
+
+bool CoverageScheduler::LoadCorpus(const std::string &filename) {
+  std::ifstream f(filename);
+  if (!f) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(f, line)) {
+    std::istringstream iss(line);
+    struct CorpusEntry e {
+      Fault{0, 0}, FaultOutcome::kNoEffect, 0, 1.0
+    };
+    std::string outcome;
+    if (!(iss >> e.fault.temporal >> e.fault.spatial >> outcome >>
+          e.new_features) ||
+        !space_.Contains(e.fault)) {
+      continue;
+    }
+    for (unsigned int o = 0;
+         o < static_cast<unsigned int>(FaultOutcome::kNumOutcomes); ++o) {
+      if (outcome == FaultOutcomeName(static_cast<FaultOutcome>(o))) {
+        e.outcome = static_cast<FaultOutcome>(o);
+      }
+    }
+    e.energy = InitialEnergy(e.outcome, e.new_features);
+    // Faults of the corpus are already known
+    const uint64_t index = space_.IndexOf(e.fault);
+    if (!IsSelected(index)) {
+      neighbours_.insert(index);
+      selected_++;
+    }
+    AddToCorpus(e);
+  }
+  return true;
+}
@@ -0,0 +1,179 @@
+#ifndef COVERAGE_SCHEDULER_H_
+#define COVERAGE_SCHEDULER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "fault_injection.h"
+#include "fault_space.h"
+
+/**
+ * Behaviour features observed in the runs of a campaign.
+ *
+ * Features of a run, e.g. visited state transitions or hit coverage points,
+ * are hashed into a bitmap. `Commit` merges them into the features of all
+ * runs and returns the number of features which were never seen before. The
+ * bitmaps are allocated once, collecting features does not allocate.
+ */
+class CoverageMap {
+ public:
+  static const unsigned int kMaxBits = 24;
+
+  /**
+   * Create a map of 2^`bits` features, `bits` is limited to 1 to `kMaxBits`.
+   */
+  explicit CoverageMap(unsigned int bits = 16);
+
+  /**
+   * Add a value of the design state, e.g. the state of a state machine.
+   *
+   * The feature is the transition from the previously observed value, so
+   * calling this each cycle covers the paths through the state space.
+   */
+  void Observe(uint64_t value);
+
+  /**
+   * Add the coverage counters of a Verilator model built with `--coverage`,
+   * i.e. `top->rootp->vlSymsp->__Vcoverage`, plain or atomic 32-bit counters.
+   *
+   * Each counter contributes a feature for its hit count, bucketed in powers
+   * of two. Must be called once at the end of a run, the counters must be
+   * cleared at the start of each run with `coveragep()->zero()` of the
+   * `VerilatedContext`.
+   */
+  template <typename T, size_t N>
+  void ObserveCounters(const T (&counters)[N]) {
+    for (size_t i = 0; i < N; ++i) {
+      ObserveCounter(i, counters[i]);
+    }
+  }
+
+  /**
+   * Add the hit count of a single coverage counter.
+   */
+  void ObserveCounter(size_t index, uint32_t count);
+
+  /**
+   * Merge the features of the run and prepare the next run.
+   *
+   * Returns the number of new features.
+   */
+  uint64_t Commit();
+
+  /**
+   * Number of features seen in all committed runs.
+   */
+  uint64_t Size() const { return total_count_; }
+
+ private:
+  const uint64_t mask_;
+  std::vector<uint8_t> run_;
+  std::vector<uint8_t> total_;
+  // Set entries of `run_`, to clear the run in time proportional to its size
+  std::vector<size_t> touched_;
+  uint64_t previous_ = 0;
+  uint64_t total_count_ = 0;
+
+  void Add(uint64_t feature);
+};
+
+/**
+ * Fault selection which prefers faults close to faults with new behaviour.
+ *
+ * A share of the faults is taken uniformly from the pseudo-random order of
+ * the fault space (see `FaultSpace::Permute`). All other faults are neighbours
+ * of a corpus entry: the same or a nearby bit a few cycles earlier or later.
+ * A fault enters the corpus if its run showed new features or leaked data.
+ * Corpus entries are selected by their energy, which grows when their
+ * neighbours are interesting and decays otherwise, in logarithmic time. No
+ * fault is selected twice: the faults taken from the pseudo-random order are
+ * known by their position in it, only neighbours are stored.
+ */
+class CoverageScheduler {
+ public:
+  struct CorpusEntry {
+    struct Fault fault;
+    FaultOutcome outcome;
+    uint64_t new_features;
+    double energy;
+  };
+
+  explicit CoverageScheduler(const FaultSpace &space, uint64_t seed = 0);
+
+  /**
+   * Set the share of uniformly selected faults, default is 0.2.
+   */
+  void SetExploration(double ratio) { exploration_ = ratio; }
+
+  /**
+   * Set the distance of a neighbour in cycles and bits, default is 4 and 1.
+   */
+  void SetRadius(uint64_t temporal, uint64_t spatial) {
+    temporal_radius_ = temporal;
+    spatial_radius_ = spatial;
+  }
+
+  /**
+   * Select the next fault. Returns false if all faults were selected.
+   */
+  bool Next(struct Fault &f);
+
+  /**
+   * Add the result of the run of the last selected fault.
+   */
+  void Report(const struct Fault &f, FaultOutcome outcome,
+              uint64_t new_features);
+
+  const std::vector<struct CorpusEntry> &Corpus() const { return corpus_; }
+
+  /**
+   * Number of selected faults.
+   */
+  uint64_t Selected() const { return selected_; }
+
+  /**
+   * Store the corpus as text, one entry per line.
+   */
+  bool SaveCorpus(const std::string &filename) const;
+
+  /**
+   * Add the entries of a stored corpus, e.g. of an earlier campaign. Faults
+   * outside of the space are ignored.
+   */
+  bool LoadCorpus(const std::string &filename);
+
+ private:
+  static const size_t kNoParent = static_cast<size_t>(-1);
+  static const unsigned int kMutationAttempts = 16;
+
+  const FaultSpace space_;
+  uint64_t rng_;
+  double exploration_ = 0.2;
+  uint64_t temporal_radius_ = 4;
+  uint64_t spatial_radius_ = 1;
+  // Next index of the pseudo-random order, all faults before were selected
+  uint64_t explore_next_ = 0;
+  // Selected faults which are not before `explore_next_`
+  std::unordered_set<uint64_t> neighbours_;
+  uint64_t selected_ = 0;
+  std::vector<struct CorpusEntry> corpus_;
+  // Fenwick tree of the energy of the corpus entries
+  std::vector<double> energy_tree_;
+  // Last selected fault and the corpus entry it was derived from
+  struct Fault last_ = Fault{0, 0};
+  size_t parent_ = kNoParent;
+
+  uint64_t Random();
+  bool IsSelected(uint64_t index) const;
+  bool Explore(struct Fault &f);
+  bool Mutate(struct Fault &f);
+  void AddToCorpus(const struct CorpusEntry &e);
+  void AddEnergy(size_t entry, double delta);
+  // Corpus entry in which the running sum of the energy exceeds `pick`
+  size_t FindEnergy(double pick) const;
+};
+
+#endif  // COVERAGE_SCHEDULER_H_
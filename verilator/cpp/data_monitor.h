@@ -2,6 +2,7 @@
 #define DATA_MONITOR_H_
 
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
 #include <string>
 
@@ -13,6 +14,9 @@ class DataMonitor {
   DataMonitor(const char *name, T *signal, T compare_values[],
               size_t compare_length);
   bool Compare(std::string &log);
+  // Report the matched value instead of creating a log text
+  bool Match(uint64_t &value);
+  const char *Name() const { return name_.c_str(); }
 
  private:
   const std::string name_;
@@ -38,6 +42,17 @@ bool DataMonitor<T>::Compare(std::string &log) {
   return false;
 }
 
+template <typename T>
+bool DataMonitor<T>::Match(uint64_t &value) {
+  for (size_t i = 0; i < compare_length_; ++i) {
+    if (compare_values_[i] == *signal_) {
+      value = static_cast<uint64_t>(compare_values_[i]);
+      return true;
+    }
+  }
+  return false;
+}
+
 template <typename T>
 DataMonitor<T>::DataMonitor(const char *name, T *signal, T compare_values[],
                             size_t compare_length)
@@ -0,0 +1,130 @@
+#ifndef EVENT_BUFFER_H_
+#define EVENT_BUFFER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "fault_space.h"
+
+enum class EventKind : uint16_t {
+  kConfiguredRange = 0,
+  kConfiguredPrecise,
+  kInserted,
+  kAbortDetected,
+  kAbortExpired,
+  kDataMatch,
+  kMemoryFlip,
+  kTriggered
+};
+
+/**
+ * Binary record of something which happened during a run.
+ *
+ * `monitor` is the index of the abort watch, value comparator or memory which
+ * created the event, `value` an optional payload such as the matched data
+ * value or the address of a memory fault. Events of a string based value
+ * comparator carry their text in the buffer, see `EventBuffer::Text`.
+ */
+struct Event {
+  uint64_t cycle;
+  struct Fault fault;
+  uint64_t value;
+  EventKind kind;
+  uint16_t monitor;
+  // Length of the text, `value` is then its offset in the text arena
+  uint32_t text_length = 0;
+};
+
+/**
+ * Preallocated buffer of the events of a run.
+ *
+ * Adding an event never allocates. The texts of events are copied into a
+ * fixed arena, a text which does not fit is truncated. If the buffer is full,
+ * newer events are not recorded and counted as dropped, so the configuration,
+ * the insertion and the first failure of a run are kept.
+ */
+class EventBuffer {
+ public:
+  EventBuffer(size_t capacity, size_t text_capacity)
+      : events_(capacity ? capacity : 1), text_(text_capacity) {}
+
+  void Push(const struct Event &e) {
+    if (size_ == events_.size()) {
+      dropped_++;
+      return;
+    }
+    events_[size_++] = e;
+  }
+
+  /**
+   * Add an event with a text, e.g. the match of a string based comparator.
+   */
+  void Push(struct Event e, const std::string &text) {
+    if (size_ == events_.size()) {
+      dropped_++;
+      return;
+    }
+    size_t length = text.size();
+    if (length > text_.size() - text_size_) {
+      length = text_.size() - text_size_;
+      truncated_++;
+    }
+    if (length) {
+      std::memcpy(&text_[text_size_], text.data(), length);
+    }
+    e.value = text_size_;
+    e.text_length = static_cast<uint32_t>(length);
+    text_size_ += length;
+    events_[size_++] = e;
+  }
+
+  /**
+   * Remove all events.
+   */
+  void Clear() {
+    size_ = 0;
+    dropped_ = 0;
+    text_size_ = 0;
+    truncated_ = 0;
+  }
+
+  /**
+   * Change the number of events and the bytes of text, removes all events.
+   */
+  void Resize(size_t capacity, size_t text_capacity) {
+    events_.assign(capacity ? capacity : 1, Event());
+    text_.assign(text_capacity, 0);
+    Clear();
+  }
+
+  /**
+   * Get an event, index 0 is the oldest event.
+   */
+  const struct Event &At(size_t index) const { return events_[index]; }
+
+  /**
+   * Text of an event, empty if the event has none.
+   */
+  std::string Text(const struct Event &e) const {
+    return e.text_length ? std::string(&text_[e.value], e.text_length)
+                         : std::string();
+  }
+
+  size_t Size() const { return size_; }
+  uint64_t Dropped() const { return dropped_; }
+  // Number of events whose text was truncated
+  uint64_t Truncated() const { return truncated_; }
+
+ private:
+  std::vector<struct Event> events_;
+  size_t size_ = 0;
+  uint64_t dropped_ = 0;
+  std::vector<char> text_;
+  size_t text_size_ = 0;
+  uint64_t truncated_ = 0;
+};
+
+#endif  // EVENT_BUFFER_H_
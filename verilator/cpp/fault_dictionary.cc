@@ -0,0 +1,332 @@
+#include "fault_dictionary.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+#include "fault_injection.h"
+
+namespace {
+
+const char kMagic[8] = {'F', 'I', 'F', 'O', 'D', 'I', 'C', 'T'};
+const uint32_t kVersion = 1;
+
+uint64_t Mix(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  return x ^ (x >> 33);
+}
+
+// Hash of the text of an event, stable between builds unlike `std::hash`
+uint64_t HashText(const std::string &text) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (unsigned char c : text) {
+    h = (h ^ c) * 0x100000001b3ULL;
+  }
+  return h;
+}
+
+struct LogRecord {
+  uint64_t hash;
+  uint64_t fault_id;
+};
+
+// Read all (signature hash, fault id) pairs of the log file
+std::vector<std::pair<uint64_t, uint64_t>> ReadLog(const std::string &path) {
+  std::vector<std::pair<uint64_t, uint64_t>> entries;
+  std::ifstream f(path, std::ios::binary);
+  struct LogRecord r;
+  while (f.read(reinterpret_cast<char *>(&r), sizeof(r))) {
+    entries.push_back(std::make_pair(r.hash, r.fault_id));
+  }
+  return entries;
+}
+
+}  // namespace
+
+struct FaultDictionary::Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t num_buckets;
+  uint64_t num_signatures;
+  uint64_t num_postings;
+};
+
+// Empty if `count` is 0
+struct FaultDictionary::Bucket {
+  uint64_t hash;
+  uint64_t offset;
+  uint64_t count;
+};
+
+struct FailureSignature FailureSignature::FromObservation(uint64_t cycle,
+                                                         EventKind kind,
+                                                         uint64_t value,
+                                                         uint32_t monitor) {
+  return FailureSignature{
+      cycle, Mix(static_cast<uint64_t>(kind) ^ Mix(value)), monitor};
+}
+
+struct FailureSignature FailureSignature::FromObservation(
+    uint64_t cycle, EventKind kind, const std::string &text,
+    uint32_t monitor) {
+  return FromObservation(cycle, kind, HashText(text), monitor);
+}
+
+struct FailureSignature FailureSignature::FromEvents(
+    const EventBuffer &events) {
+  for (size_t i = 0; i < events.Size(); ++i) {
+    const struct Event &e = events.At(i);
+    if (e.kind == EventKind::kAbortDetected ||
+        e.kind == EventKind::kDataMatch) {
+      if (e.text_length) {
+        return FromObservation(e.cycle, e.kind, events.Text(e), e.monitor);
+      }
+      return FromObservation(e.cycle, e.kind, e.value, e.monitor);
+    }
+  }
+  return FailureSignature{0, 0, kNoFailure};
+}
+
+uint64_t FailureSignature::Hash() const {
+  return Mix(first_divergence ^ Mix(output_hash ^ Mix(monitor)));
+}
+
+FaultDictionary::~FaultDictionary() { Close(); }
+
+bool FaultDictionary::Open(const std::string &path) {
+  Close();
+  path_ = path;
+  if (!MapIndex()) {
+    return false;
+  }
+  // A dictionary can consist only of the log
+  return Refresh();
+}
+
+bool FaultDictionary::MapIndex() {
+  int fd = ::open(path_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return true;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 &&
+      static_cast<size_t>(st.st_size) >= sizeof(struct Header)) {
+    map_size_ = st.st_size;
+    map_ = mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (map_ == MAP_FAILED) {
+      map_ = nullptr;
+    }
+    index_device_ = st.st_dev;
+    index_inode_ = st.st_ino;
+    index_mtime_ = st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+  }
+  ::close(fd);
+  if (map_ == nullptr) {
+    return false;
+  }
+  header_ = static_cast<const struct Header *>(map_);
+  if (std::memcmp(header_->magic, kMagic, sizeof(kMagic)) ||
+      header_->version != kVersion ||
+      map_size_ < sizeof(struct Header) +
+                      header_->num_buckets * sizeof(struct Bucket) +
+                      header_->num_postings * sizeof(uint64_t)) {
+    UnmapIndex();
+    return false;
+  }
+  buckets_ = reinterpret_cast<const struct Bucket *>(header_ + 1);
+  postings_ =
+      reinterpret_cast<const uint64_t *>(buckets_ + header_->num_buckets);
+  return true;
+}
+
+void FaultDictionary::UnmapIndex() {
+  if (map_ != nullptr) {
+    munmap(map_, map_size_);
+  }
+  map_ = nullptr;
+  map_size_ = 0;
+  header_ = nullptr;
+  buckets_ = nullptr;
+  postings_ = nullptr;
+}
+
+void FaultDictionary::Close() {
+  UnmapIndex();
+  pending_.clear();
+}
+
+bool FaultDictionary::Refresh() {
+  // `Compact` replaces the index by a new file, the mapping still shows the
+  // old one
+  struct stat st;
+  bool exists = stat(path_.c_str(), &st) == 0;
+  bool replaced = exists != (map_ != nullptr);
+  if (exists && map_ != nullptr) {
+    replaced = static_cast<uint64_t>(st.st_dev) != index_device_ ||
+               static_cast<uint64_t>(st.st_ino) != index_inode_ ||
+               static_cast<size_t>(st.st_size) != map_size_ ||
+               st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec !=
+                   index_mtime_;
+  }
+  if (replaced) {
+    UnmapIndex();
+    if (!MapIndex()) {
+      return false;
+    }
+  }
+  pending_.clear();
+  for (auto &e : ReadLog(path_ + ".log")) {
+    pending_[e.first].push_back(e.second);
+  }
+  return true;
+}
+
+uint64_t FaultDictionary::NumSignatures() const {
+  return header_ ? header_->num_signatures : 0;
+}
+
+std::vector<uint64_t> FaultDictionary::Lookup(uint64_t signature_hash) const {
+  std::vector<uint64_t> ids;
+  if (header_ != nullptr && header_->num_buckets) {
+    const uint64_t mask = header_->num_buckets - 1;
+    // Linear probing, the table is at most half full
+    for (uint64_t b = signature_hash & mask; buckets_[b].count;
+         b = (b + 1) & mask) {
+      if (buckets_[b].hash == signature_hash) {
+        ids.assign(postings_ + buckets_[b].offset,
+                   postings_ + buckets_[b].offset + buckets_[b].count);
+        break;
+      }
+    }
+  }
+  auto p = pending_.find(signature_hash);
+  if (p != pending_.end()) {
+    size_t indexed = ids.size();
+    ids.insert(ids.end(), p->second.begin(), p->second.end());
+    std::sort(ids.begin() + indexed, ids.end());
+    std::inplace_merge(ids.begin(), ids.begin() + indexed, ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  }
+  return ids;
+}
+
+FaultDictionaryWriter::FaultDictionaryWriter(const std::string &path)
+    : path_(path),
+      log_(path + ".log", std::ios::binary | std::ios::app),
+      logged_(ReadLog(path + ".log").size()) {}
+
+FaultDictionaryWriter::~FaultDictionaryWriter() { log_.flush(); }
+
+bool FaultDictionaryWriter::Add(const struct FailureSignature &s,
+                                uint64_t fault_id) {
+  // Runs without a failure are the majority and never looked up
+  if (s.monitor == FailureSignature::kNoFailure) {
+    return true;
+  }
+  struct LogRecord r {
+    s.Hash(), fault_id
+  };
+  log_.write(reinterpret_cast<const char *>(&r), sizeof(r));
+  // Make the entry visible to readers
+  log_.flush();
+  if (!log_.good()) {
+    return false;
+  }
+  logged_++;
+  if (threshold_ && logged_ >= threshold_) {
+    return Compact();
+  }
+  return true;
+}
+
+bool FaultDictionaryWriter::Add(FaultInjection &fi) {
+  // The fault id is only defined within the fault space, e.g. not for `-i`
+  if (!fi.GetFullSpace().Contains(fi.GetFaultSpace())) {
+    return false;
+  }
+  return Add(FailureSignature::FromEvents(fi.Events()), fi.FaultId());
+}
+
+bool FaultDictionaryWriter::Compact() {
+  log_.flush();
+  // Collect the entries of the current index and the log
+  std::vector<std::pair<uint64_t, uint64_t>> entries = ReadLog(path_ + ".log");
+  {
+    FaultDictionary old;
+    if (old.Open(path_) && old.header_ != nullptr) {
+      for (uint64_t b = 0; b < old.header_->num_buckets; ++b) {
+        const FaultDictionary::Bucket &k = old.buckets_[b];
+        for (uint64_t i = 0; i < k.count; ++i) {
+          entries.push_back(
+              std::make_pair(k.hash, old.postings_[k.offset + i]));
+        }
+      }
+    }
+  }
+  std::sort(entries.begin(), entries.end());
+  entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+  FaultDictionary::Header header;
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.reserved = 0;
+  header.num_signatures = 0;
+  header.num_postings = entries.size();
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (i == 0 || entries[i].first != entries[i - 1].first) {
+      header.num_signatures++;
+    }
+  }
+  header.num_buckets = 1;
+  while (header.num_buckets < 2 * header.num_signatures) {
+    header.num_buckets <<= 1;
+  }
+  std::vector<FaultDictionary::Bucket> buckets(
+      header.num_buckets, FaultDictionary::Bucket{0, 0, 0});
+  std::vector<uint64_t> postings(entries.size());
+  const uint64_t mask = header.num_buckets - 1;
+  for (size_t i = 0; i < entries.size();) {
+    size_t j = i;
+    while (j < entries.size() && entries[j].first == entries[i].first) {
+      postings[j] = entries[j].second;
+      j++;
+    }
+    uint64_t b = entries[i].first & mask;
+    while (buckets[b].count) {
+      b = (b + 1) & mask;
+    }
+    buckets[b] = FaultDictionary::Bucket{entries[i].first, i, j - i};
+    i = j;
+  }
+
+  // Replace the index atomically, then start a new log
+  std::string tmp = path_ + ".tmp";
+  {
+    std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+    f.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    f.write(reinterpret_cast<const char *>(buckets.data()),
+            buckets.size() * sizeof(FaultDictionary::Bucket));
+    f.write(reinterpret_cast<const char *>(postings.data()),
+            postings.size() * sizeof(uint64_t));
+    if (!f.good()) {
+      return false;
+    }
+  }
+  if (std::rename(tmp.c_str(), path_.c_str()) != 0) {
+    return false;
+  }
+  log_.close();
+  log_.open(path_ + ".log", std::ios::binary | std::ios::trunc);
+  logged_ = 0;
+  return log_.good();
+}
@@ -0,0 +1,155 @@
+#ifndef FAULT_DICTIONARY_H_
+#define FAULT_DICTIONARY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "event_buffer.h"
+
+class FaultInjection;
+
+/**
+ * Observed failure of a run: the first cycle in which an abort watch or a
+ * value comparator fired, which one fired and the reported value.
+ */
+struct FailureSignature {
+  uint64_t first_divergence;
+  uint64_t output_hash;
+  uint32_t monitor;
+
+  /**
+   * Signature of a run without any observed failure.
+   */
+  static const uint32_t kNoFailure = 0xffffffff;
+
+  /**
+   * Create the signature of a failure observed in `cycle`, e.g. to look up
+   * the faults which explain a failure of a device.
+   *
+   * `kind` is `EventKind::kAbortDetected` or `EventKind::kDataMatch`,
+   * `monitor` the index of the abort watch or value comparator and `value`
+   * the matched value, 0 for an abort.
+   */
+  static struct FailureSignature FromObservation(uint64_t cycle,
+                                                 EventKind kind,
+                                                 uint64_t value,
+                                                 uint32_t monitor);
+
+  /**
+   * Signature of a data match reported by a string based value comparator.
+   */
+  static struct FailureSignature FromObservation(uint64_t cycle,
+                                                 EventKind kind,
+                                                 const std::string &text,
+                                                 uint32_t monitor);
+
+  /**
+   * Create the signature from the first abort or data match event of a run.
+   */
+  static struct FailureSignature FromEvents(const EventBuffer &events);
+
+  uint64_t Hash() const;
+};
+
+/**
+ * Read-only view of a fault dictionary, mapping failure signatures to the
+ * sorted list of fault identifiers which caused them.
+ *
+ * The index file is memory mapped, a lookup is a hash table probe followed by
+ * a copy of the posting list. Entries not yet merged into the index (see
+ * `FaultDictionaryWriter`) are loaded from the log file when the dictionary is
+ * opened or refreshed.
+ */
+class FaultDictionary {
+ public:
+  FaultDictionary() = default;
+  ~FaultDictionary();
+  FaultDictionary(const FaultDictionary &) = delete;
+  FaultDictionary &operator=(const FaultDictionary &) = delete;
+
+  bool Open(const std::string &path);
+  void Close();
+
+  /**
+   * Reload the entries of the log file. If the index was replaced, e.g. by
+   * `FaultDictionaryWriter::Compact`, the new index is mapped.
+   */
+  bool Refresh();
+
+  std::vector<uint64_t> Lookup(const struct FailureSignature &s) const {
+    return Lookup(s.Hash());
+  }
+  std::vector<uint64_t> Lookup(uint64_t signature_hash) const;
+
+  /**
+   * Number of distinct signatures in the index.
+   */
+  uint64_t NumSignatures() const;
+
+ private:
+  struct Header;
+  struct Bucket;
+
+  std::string path_;
+  void *map_ = nullptr;
+  size_t map_size_ = 0;
+  const struct Header *header_ = nullptr;
+  const struct Bucket *buckets_ = nullptr;
+  const uint64_t *postings_ = nullptr;
+  // Identity of the mapped index file
+  uint64_t index_device_ = 0;
+  uint64_t index_inode_ = 0;
+  uint64_t index_mtime_ = 0;
+  std::unordered_map<uint64_t, std::vector<uint64_t>> pending_;
+
+  // Map the index file, a missing file is an empty index
+  bool MapIndex();
+  void UnmapIndex();
+
+  friend class FaultDictionaryWriter;
+};
+
+/**
+ * Incrementally build a fault dictionary at `path`.
+ *
+ * New entries are appended to `<path>.log` and become visible to readers
+ * immediately. `Compact` merges the log into the hashed index `<path>`.
+ */
+class FaultDictionaryWriter {
+ public:
+  explicit FaultDictionaryWriter(const std::string &path);
+  ~FaultDictionaryWriter();
+
+  /**
+   * Add the fault of a failure. Signatures without a failure
+   * (`FailureSignature::kNoFailure`) are not stored.
+   */
+  bool Add(const struct FailureSignature &s, uint64_t fault_id);
+
+  /**
+   * Add the result of the current run of `fi`.
+   *
+   * Returns false if the fault lies outside of the fault space, since it has
+   * no fault id.
+   */
+  bool Add(FaultInjection &fi);
+
+  /**
+   * Merge the log into the index. Called automatically after `threshold`
+   * added entries, a value of 0 disables the automatic merge.
+   */
+  bool Compact();
+  void SetCompactThreshold(uint64_t threshold) { threshold_ = threshold; }
+
+ private:
+  std::string path_;
+  std::ofstream log_;
+  uint64_t logged_ = 0;
+  uint64_t threshold_ = 1 << 20;
+};
+
+#endif  // FAULT_DICTIONARY_H_
@@ -2,10 +2,11 @@
 
 #include <getopt.h>
 
-#include <cstdlib>
+#include <algorithm>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <utility>
 
@@ -16,61 +17,171 @@ FaultInjection::FaultInjection(unsigned int fi_signal_len)
       cycle_count_(0),
       num_iterations_(1),
       sequential_(false),
-      inject_specific_(false) {
+      inject_specific_(false),
+      events_(1024, 64 * 1024) {
   // Set default values
   active_fault_ = Fault{1, 1};
   temporal_limit_ = Temporal{1, 1};
 }
 
-void FaultInjection::SetModeRange(unsigned int temporal_start,
-                                  unsigned int temporal_duration,
+void FaultInjection::SetModeRange(uint64_t temporal_start,
+                                  uint64_t temporal_duration,
                                   bool mode_sequential,
-                                  unsigned long int iteration_count) {
+                                  uint64_t iteration_count) {
   temporal_limit_ = Temporal{temporal_start, temporal_duration};
   sequential_ = mode_sequential;
   SetFaultRange(iteration_count);
 }
 
-void FaultInjection::SetModePrecise(unsigned int fault_temporal,
-                                    unsigned int fault_spatial) {
+void FaultInjection::SetModePrecise(uint64_t fault_temporal,
+                                    uint64_t fault_spatial) {
   active_fault_ = Fault{fault_temporal, fault_spatial};
-  log_ << "Fault injection configured with:\nfault signal width: "
-       << num_fi_signals << "\nfault cycle: " << active_fault_.temporal
-       << "\nfault signal number: " << active_fault_.spatial << std::endl;
+  events_.Push(
+      Event{cycle_count_, active_fault_, 0, EventKind::kConfiguredPrecise, 0});
 }
 
-void FaultInjection::UpdateSpace(unsigned long int iteration_count) {
-  log_.clear();
-  log_.str("");
-  injected_ = false;
+void FaultInjection::UpdateSpace(uint64_t iteration_count) {
+  ResetRun();
   SetFaultRange(iteration_count);
 }
 
-void FaultInjection::SetFaultRange(unsigned long int iteration_count) {
+void FaultInjection::UpdateSpace(const struct Fault &fault) {
+  ResetRun();
+  SetModePrecise(fault.temporal, fault.spatial);
+}
+
+void FaultInjection::ResetRun() {
+  events_.Clear();
+  memory_flips_.clear();
+  memory_active_ = false;
+  memory_injected_ = false;
+  injected_ = false;
+  abort_watch_list_.Reset();
+  injection_duration_ = fault_length_;
+  cycle_count_ = 0;
+  abort_detected_ = false;
+  data_matched_ = false;
+  trigger_.Reset();
+  trigger_count_ = 0;
+  trigger_cycle_ = 0;
+  trigger_missed_ = false;
+  trigger_replay_ = false;
+}
+
+void FaultInjection::SetCycle(uint64_t cycle) {
+  cycle_count_ = cycle;
+  if (!trigger_occurrence_ || trigger_history_.size() < trigger_occurrence_) {
+    return;
+  }
+  // Occurrences before the restored cycle are not seen again
+  trigger_count_ = std::upper_bound(trigger_history_.begin(),
+                                    trigger_history_.end(), cycle) -
+                   trigger_history_.begin();
+  trigger_cycle_ =
+      trigger_count_ == trigger_occurrence_ ? trigger_history_.back() : 0;
+  // A level condition which holds at the restored cycle would be counted
+  // again by a new scan of the signal, the later occurrences are replayed
+  // from the history instead
+  trigger_replay_ = true;
+}
+
+uint64_t FaultInjection::InjectionCycle() const {
+  if (!trigger_occurrence_) {
+    return active_fault_.temporal;
+  }
+  uint64_t base = trigger_cycle_;
+  if (!base && trigger_history_.size() == trigger_occurrence_) {
+    base = trigger_history_.back();
+  }
+  if (!base) {
+    return 0;
+  }
+  base += active_fault_.temporal;
+  // The first cycle in which a fault can be inserted is 1
+  return base > trigger_lead_ ? base - trigger_lead_ : 1;
+}
+
+bool FaultInjection::InjectionDue() {
+  if (!trigger_occurrence_) {
+    return cycle_count_ >= active_fault_.temporal;
+  }
+  if (trigger_replay_) {
+    while (!trigger_cycle_ &&
+           trigger_history_[trigger_count_] <= cycle_count_) {
+      if (++trigger_count_ == trigger_occurrence_) {
+        trigger_cycle_ = trigger_history_.back();
+        events_.Push(Event{trigger_cycle_, active_fault_, trigger_count_,
+                           EventKind::kTriggered, 0});
+      }
+    }
+  } else if (!trigger_cycle_) {
+    trigger_.Scan([this](size_t) {
+      if (++trigger_count_ != trigger_occurrence_) {
+        if (trigger_count_ > trigger_history_.size()) {
+          trigger_history_.push_back(cycle_count_);
+        }
+        return;
+      }
+      const bool known = trigger_history_.size() == trigger_occurrence_;
+      if (!known) {
+        trigger_history_.push_back(cycle_count_);
+      }
+      trigger_cycle_ = cycle_count_;
+      events_.Push(Event{cycle_count_, active_fault_, trigger_count_,
+                         EventKind::kTriggered, 0});
+      // A fault before the trigger can only be inserted if the trigger cycle
+      // is known from an earlier run
+      trigger_missed_ = !known && InjectionCycle() < cycle_count_;
+    });
+  }
+  if (trigger_missed_) {
+    return false;
+  }
+  uint64_t at = InjectionCycle();
+  return at && cycle_count_ >= at;
+}
+
+void FaultInjection::SetScheduleBlock(uint64_t block_length) {
+  schedule_block_ = block_length;
+  schedule_.clear();
+}
+
+FaultSpace FaultInjection::GetFullSpace() const {
+  return FaultSpace(temporal_limit_.start, temporal_limit_.duration,
+                    num_fi_signals, seed_);
+}
+
+void FaultInjection::SetFaultRange(uint64_t iteration_count) {
+  FaultSpace space = GetFullSpace();
   // Two different ways to set the fault for a specific run.
   if (sequential_) {
     // Sequential mode needs the current iteration number and will then iterate
     // over the space. Low frequency for clock and high frequency for position.
-    active_fault_.temporal =
-        iteration_count / num_fi_signals + temporal_limit_.start;
-    active_fault_.spatial = iteration_count % num_fi_signals;
+    active_fault_ = space.At(iteration_count);
+  } else if (schedule_block_ > 1) {
+    // Random order without repetition, sorted by cycle within a block
+    uint64_t start = iteration_count - iteration_count % schedule_block_;
+    if (schedule_.empty() || schedule_start_ != start) {
+      schedule_.resize(schedule_block_);
+      for (uint64_t i = 0; i < schedule_block_; ++i) {
+        schedule_[i] = space.Permute(start + i);
+      }
+      // Indices are ordered temporal-major, see `FaultSpace`
+      std::sort(schedule_.begin(), schedule_.end());
+      schedule_start_ = start;
+    }
+    active_fault_ = space.At(schedule_[iteration_count - start]);
   } else {
-    // Choose values randomly
-    // TODO: Allow to set a manual seed or at some other randomness.
-    active_fault_.temporal =
-        rand() % temporal_limit_.start + temporal_limit_.duration;
-    active_fault_.spatial = rand() % (num_fi_signals + 1);
+    // Random order without repetition
+    active_fault_ = space.RandomAt(iteration_count);
   }
-  log_ << "Fault injection configured with:\n\tfault cycle ["
-       << temporal_limit_.start << ":" << temporal_limit_.duration << "]:\t"
-       << active_fault_.temporal
-       << "\n\tfault signal number [0:" << num_fi_signals - 1 << "]:\t"
-       << active_fault_.spatial << std::endl;
+  events_.Push(
+      Event{cycle_count_, active_fault_, 0, EventKind::kConfiguredRange, 0});
 }
 
-std::pair<int, int> ExtractPairValue(std::string str) {
+std::pair<uint64_t, uint64_t> ExtractPairValue(std::string str) {
   std::istringstream iss;
-  int first, second;
+  uint64_t first, second;
   char separator;
   iss.str(str);
   // Number; single character as separator; number
@@ -85,14 +196,21 @@ bool FaultInjection::ParseCommandArgs(int argc, char **argv, bool &exit_app) {
       {"sequential", no_argument, nullptr, 's'},
       {"inject", required_argument, nullptr, 'i'},
       {"temporal-limits", required_argument, nullptr, 'z'},
+      {"seed", required_argument, nullptr, 'r'},
+      {"part", required_argument, nullptr, 'p'},
+      {"daemon", required_argument, nullptr, 'D'},
+      {"tuning", required_argument, nullptr, 'T'},
+      {"guided", required_argument, nullptr, 'G'},
       {"help", no_argument, nullptr, 'h'},
       {nullptr, no_argument, nullptr, 0}};
   optind = 1;
-  std::pair<int, int> inject_space;
-  std::pair<int, int> temporal_limit;
+  std::pair<uint64_t, uint64_t> inject_space;
+  std::pair<uint64_t, uint64_t> temporal_limit;
+  std::pair<uint64_t, uint64_t> part(0, 1);
 
   while (1) {
-    int c = getopt_long(argc, argv, ":n:si:z:h", long_options, nullptr);
+    int c = getopt_long(argc, argv, ":n:si:z:r:p:D:T:G:h", long_options,
+                        nullptr);
     if (c == -1) {
       break;
     }
@@ -113,11 +231,22 @@ bool FaultInjection::ParseCommandArgs(int argc, char **argv, bool &exit_app) {
                "injection\n\n"
                "-z|--temporal-limits=t0,td\n  Restrict temporal space\n"
                "  Start time,Duration\n\n"
+               "-r|--seed=N\n  Seed for the random order of the fault space\n\n"
+               "-p|--part=k,n\n  Only run the k-th of n equally sized parts of "
+               "the iterations\n\n"
+               "-D|--daemon=path\n  Keep running and accept fault jobs on "
+               "the Unix socket at path, see `CampaignDaemon`\n\n"
+               "-T|--tuning=file\n  Run the iterations in parallel with the "
+               "configuration stored in file, calibrate and store it if "
+               "missing, see `ParallelTuner`\n\n"
+               "-G|--guided=file\n  Select the faults by the coverage of "
+               "earlier runs, the corpus is loaded from and stored to file, "
+               "see `CoverageScheduler`\n\n"
             << std::endl;
         exit_app = true;
         break;
       case 'n':
-        num_iterations_ = std::stoul(optarg);
+        num_iterations_ = std::stoull(optarg);
         break;
       case 's':
         sequential_ = true;
@@ -125,15 +254,49 @@ bool FaultInjection::ParseCommandArgs(int argc, char **argv, bool &exit_app) {
       case 'i':
         // Parse data from "12,34"
         inject_space = ExtractPairValue(optarg);
-        active_fault_ = Fault{static_cast<unsigned int>(inject_space.first),
-                              static_cast<unsigned int>(inject_space.second)};
+        active_fault_ = Fault{inject_space.first, inject_space.second};
         inject_specific_ = true;
         break;
       case 'z':
         temporal_limit = ExtractPairValue(optarg);
-        temporal_limit_ =
-            Temporal{static_cast<unsigned int>(temporal_limit.first),
-                     static_cast<unsigned int>(temporal_limit.second)};
+        if (!temporal_limit.second) {
+          std::cerr << "ERROR: Empty temporal limits." << std::endl
+                    << std::endl;
+          exit_app = true;
+          return false;
+        }
+        if (num_fi_signals &&
+            temporal_limit.second >
+                std::numeric_limits<uint64_t>::max() / num_fi_signals) {
+          std::cerr << "ERROR: Temporal limits exceed the fault space."
+                    << std::endl
+                    << std::endl;
+          exit_app = true;
+          return false;
+        }
+        temporal_limit_ = Temporal{temporal_limit.first, temporal_limit.second};
+        break;
+      case 'r':
+        seed_ = std::stoull(optarg);
+        break;
+      case 'D':
+        daemon_socket_ = optarg;
+        break;
+      case 'T':
+        tuning_file_ = optarg;
+        break;
+      case 'G':
+        corpus_file_ = optarg;
+        break;
+      case 'p':
+        // Parse data from "2,8"
+        part = ExtractPairValue(optarg);
+        if (!part.second || part.first >= part.second ||
+            part.second > std::numeric_limits<uint32_t>::max()) {
+          std::cerr << "ERROR: Invalid part." << std::endl << std::endl;
+          exit_app = true;
+          return false;
+        }
         break;
       case ':':  // missing argument
         std::cerr << "ERROR: Missing argument." << std::endl << std::endl;
@@ -145,13 +308,18 @@ bool FaultInjection::ParseCommandArgs(int argc, char **argv, bool &exit_app) {
         // Verilator's built-in parsing below.
     }
   }
+  // Restrict the iterations to the selected part
+  FaultSpace::Range r =
+      FaultSpace::RangeAt(0, num_iterations_, part.second, part.first);
+  iteration_start_ = r.begin;
+  num_iterations_ = r.end - r.begin;
   if (!inject_specific_) {
-    SetFaultRange();
+    SetFaultRange(iteration_start_);
   }
   return true;
 }
 
-unsigned int FaultInjection::IterationLength() {
+uint64_t FaultInjection::IterationLength() {
   if (inject_specific_) {
     // For now only one specific testing at a time
     return 1;
@@ -159,59 +327,105 @@ unsigned int FaultInjection::IterationLength() {
   return num_iterations_;
 }
 
+uint64_t FaultInjection::IterationStart() {
+  if (inject_specific_) {
+    return 0;
+  }
+  return iteration_start_;
+}
+
 struct Fault FaultInjection::GetFaultSpace() {
   return active_fault_;
 }
 
-bool FaultInjection::Injected() { return injected_; }
+bool FaultInjection::Injected() { return injected_ || memory_injected_; }
+
+FaultOutcome FaultInjection::Outcome() const {
+  if (!injected_ && !memory_injected_) {
+    return FaultOutcome::kNotInjected;
+  }
+  if (data_matched_) {
+    return FaultOutcome::kDataMatch;
+  }
+  if (abort_detected_) {
+    return FaultOutcome::kAbort;
+  }
+  return FaultOutcome::kNoEffect;
+}
+
+const char *FaultOutcomeName(FaultOutcome outcome) {
+  switch (outcome) {
+    case FaultOutcome::kNotInjected:
+      return "not_injected";
+    case FaultOutcome::kNoEffect:
+      return "no_effect";
+    case FaultOutcome::kAbort:
+      return "abort";
+    case FaultOutcome::kDataMatch:
+      return "data_match";
+    default:
+      return "unknown";
+  }
+}
 
 void FaultInjection::DumpConfig(std::ofstream &olog) {
   olog << active_fault_ << std::endl;
 }
 
+size_t FaultInjection::AddMemory(const char *name, unsigned int offset,
+                                 unsigned int addr_bits,
+                                 unsigned int bit_bits) {
+  memories_.push_back(MemoryInfo{name, offset, addr_bits, bit_bits});
+  return memories_.size() - 1;
+}
+
+void FaultInjection::ScheduleMemoryFlip(size_t memory, uint64_t cycle,
+                                        uint64_t address, unsigned int bit) {
+  if (memory < memories_.size()) {
+    memory_flips_.push_back(MemoryFlip{memory, cycle, address, bit});
+  }
+}
+
 void FaultInjection::AddAbortWatch(const char *name, CData *signal,
                                    unsigned int delay, bool positive_polarity) {
-  abort_watch_list_.push_back(
-      AbortInfo{name, signal, positive_polarity, delay, delay, false});
+  abort_watch_list_.Add(name, signal,
+                        AbortPredicate::Equal(positive_polarity ? 1 : 0),
+                        delay);
 }
 
 bool FaultInjection::StopRequested() {
   // Only check after fault is inserted
-  if (!injected_) {
+  if (!injected_ && !memory_injected_) {
     return false;
   }
   // Check for an abort signal
-  for (auto a = abort_watch_list_.begin(); a != abort_watch_list_.end(); ++a) {
-    // Store a signal assertion
-    if (*a->signal == a->positive_polarity) {
-      a->asserted = true;
-    }
-    if (a->asserted) {
-      if (a->delay == a->delay_count) {
-        log_ << cycle_count_ << "\t" << active_fault_ << "\t"
-             << "abort signal detected"
-             << "\t" << a->name_ << std::endl;
-      }
-      // After a signal is asserted, wait for 'delay' cycles before signalling
-      // the stop request
-      if (a->delay_count > 0) {
-        a->delay_count--;
-      } else {
-        log_ << cycle_count_ << "\t" << active_fault_ << "\t"
-             << "abort signal delay expired"
-             << "\t" << a->name_ << std::endl;
-        return true;
-      }
-    }
+  size_t expired = abort_watch_list_.Check([this](size_t a) {
+    events_.Push(Event{cycle_count_, active_fault_, 0,
+                       EventKind::kAbortDetected, static_cast<uint16_t>(a)});
+  });
+  if (expired != AbortWatchList::kNone) {
+    events_.Push(Event{cycle_count_, active_fault_, 0, EventKind::kAbortExpired,
+                       static_cast<uint16_t>(expired)});
+    abort_detected_ = true;
+    return true;
   }
 
   // Compare current values against comparison list
-  for (auto m : value_compare_list_) {
-    std::string log;
-    if (m(log)) {
-      log_ << cycle_count_ << "\t" << active_fault_ << "\t"
-           << "data match"
-           << "\t" << log << std::endl;
+  for (size_t i = 0; i < value_compare_list_.size(); ++i) {
+    struct ValueComparator &m = value_compare_list_[i];
+    uint64_t value = 0;
+    bool matched = m.match ? m.match(value) : m.compare(m.text);
+    if (matched) {
+      data_matched_ = true;
+      struct Event e {
+        cycle_count_, active_fault_, value, EventKind::kDataMatch,
+            static_cast<uint16_t>(i)
+      };
+      if (m.match) {
+        events_.Push(e);
+      } else {
+        events_.Push(e, m.text);
+      }
     }
   }
   return false;
@@ -219,15 +433,77 @@ bool FaultInjection::StopRequested() {
 
 void FaultInjection::AddValueComparator(
     std::function<bool(std::string &)> &fs) {
-  value_compare_list_.push_back(fs);
+  value_compare_list_.push_back(ValueComparator{"", nullptr, fs, ""});
 }
 
-std::ostream &operator<<(std::ostream &os, const struct Fault &f) {
-  os << f.temporal << "," << f.spatial;
-  return os;
+void FaultInjection::AddValueComparator(const char *name,
+                                        std::function<bool(uint64_t &)> fs) {
+  value_compare_list_.push_back(ValueComparator{name, fs, nullptr, ""});
 }
 
 std::ostream &operator<<(std::ostream &os, const FaultInjection &f) {
-  os << f.log_.str();
+  for (size_t i = 0; i < f.events_.Size(); ++i) {
+    const struct Event &e = f.events_.At(i);
+    switch (e.kind) {
+      case EventKind::kConfiguredRange:
+        os << "Fault injection configured with:\n\tfault cycle ["
+           << f.temporal_limit_.start << ":" << f.temporal_limit_.duration
+           << "]" << (f.trigger_occurrence_ ? " after trigger" : "") << ":\t"
+           << e.fault.temporal << "\n\tfault signal number [0:"
+           << f.num_fi_signals - 1 << "]:\t" << e.fault.spatial << "\n";
+        break;
+      case EventKind::kConfiguredPrecise:
+        os << "Fault injection configured with:\nfault signal width: "
+           << f.num_fi_signals << "\nfault cycle: " << e.fault.temporal
+           << "\nfault signal number: " << e.fault.spatial << "\n";
+        break;
+      case EventKind::kInserted:
+        os << e.cycle << "\t" << e.fault << "\t"
+           << "Fault inserted\n";
+        break;
+      case EventKind::kAbortDetected:
+        os << e.cycle << "\t" << e.fault << "\t"
+           << "abort signal detected"
+           << "\t" << f.abort_watch_list_.Name(e.monitor) << "\n";
+        break;
+      case EventKind::kAbortExpired:
+        os << e.cycle << "\t" << e.fault << "\t"
+           << "abort signal delay expired"
+           << "\t" << f.abort_watch_list_.Name(e.monitor) << "\n";
+        break;
+      case EventKind::kDataMatch: {
+        const struct FaultInjection::ValueComparator &m =
+            f.value_compare_list_[e.monitor];
+        os << e.cycle << "\t" << e.fault << "\t"
+           << "data match"
+           << "\t";
+        if (m.match) {
+          os << m.name << " 0x" << std::hex << e.value << std::dec;
+        } else {
+          os << f.events_.Text(e);
+        }
+        os << "\n";
+        break;
+      }
+      case EventKind::kMemoryFlip:
+        os << e.cycle << "\t" << e.fault << "\t"
+           << "Memory bit flipped"
+           << "\t" << f.memories_[e.monitor].name << "[0x" << std::hex
+           << e.value << std::dec << "] bit " << e.fault.spatial << "\n";
+        break;
+      case EventKind::kTriggered:
+        os << e.cycle << "\t" << e.fault << "\t"
+           << "trigger fired"
+           << "\t" << f.trigger_.Name(e.monitor) << " occurrence " << e.value
+           << "\n";
+        break;
+    }
+  }
+  if (f.events_.Dropped()) {
+    os << f.events_.Dropped() << " events dropped\n";
+  }
+  if (f.events_.Truncated()) {
+    os << f.events_.Truncated() << " event texts truncated\n";
+  }
   return os;
 }
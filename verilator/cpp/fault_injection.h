@@ -7,30 +7,34 @@
 #include <fstream>
 #include <functional>
 #include <ostream>
-#include <sstream>
 #include <string>
 #include <vector>
 
-struct Fault {
-  unsigned int temporal;
-  unsigned int spatial;
-  friend std::ostream &operator<<(std::ostream &os, const struct Fault &f);
-};
+#include "abort_watch.h"
+#include "event_buffer.h"
+#include "fault_space.h"
 
-struct AbortInfo {
-  const std::string name_;
-  CData *signal;
-  bool positive_polarity;
-  const unsigned int delay;
-  unsigned int delay_count;
-  bool asserted;
+struct Temporal {
+  uint64_t start;
+  uint64_t duration;
 };
 
-struct Temporal {
-  unsigned int start;
-  unsigned int duration;
+/**
+ * Result of a single fault injection run.
+ *
+ * A run which both matched data and raised an abort signal is classified as
+ * a data match, as the data was observable before the design reacted.
+ */
+enum class FaultOutcome : unsigned int {
+  kNotInjected = 0,
+  kNoEffect,
+  kAbort,
+  kDataMatch,
+  kNumOutcomes
 };
 
+const char *FaultOutcomeName(FaultOutcome outcome);
+
 class FaultInjection {
  public:
   /**
@@ -44,12 +48,12 @@ class FaultInjection {
    * Limit the temporal space by setting boundaries.
    * The spatial selection is made depending on `mode_sequential` and
    * `iteration_count`. In a sequential mode the spatial selection is based on
-   * the current iteration. In the non-sequential mode the spatial selection is
-   * randomly assigned.
+   * the current iteration. In the non-sequential mode the fault is taken from
+   * a pseudo-random permutation of the space, see `FaultSpace::Permute`, so no
+   * fault is repeated before the whole space was covered.
    */
-  void SetModeRange(unsigned int temporal_start, unsigned int temporal_duration,
-                    bool mode_sequential,
-                    unsigned long int iteration_count = 0);
+  void SetModeRange(uint64_t temporal_start, uint64_t temporal_duration,
+                    bool mode_sequential, uint64_t iteration_count = 0);
 
   /**
    * Update the fault values based on the iteration number.
@@ -59,7 +63,13 @@ class FaultInjection {
    * analysing the arguments via `ParseCommandArgs` or by setting it via
    * `SetModeRange`.
    */
-  void UpdateSpace(unsigned long int iteration_count);
+  void UpdateSpace(uint64_t iteration_count);
+
+  /**
+   * Prepare the next run for a fault chosen by the caller, e.g. by a
+   * `CoverageScheduler`.
+   */
+  void UpdateSpace(const struct Fault &fault);
 
   /**
    * Create a specific fault injection.
@@ -67,7 +77,37 @@ class FaultInjection {
    * Set the exact temporal and spatial value for the fault injection.
    * This is useful in investigating a design after an initial exploration.
    */
-  void SetModePrecise(unsigned int fault_temporal, unsigned int fault_spatial);
+  void SetModePrecise(uint64_t fault_temporal, uint64_t fault_spatial);
+
+  /**
+   * Set the seed of the pseudo-random order of the non-sequential mode.
+   */
+  void SetSeed(uint64_t seed) { seed_ = seed; }
+
+  /**
+   * Sort the pseudo-random order in blocks by the fault cycle.
+   *
+   * Each block of `block_length` consecutive iterations covers the same faults
+   * as before, but ordered by their temporal value. Runs which restore a
+   * snapshot, see `CheckpointLadder`, then access the snapshots in order. A
+   * value of 0 or 1 disables the sorting.
+   */
+  void SetScheduleBlock(uint64_t block_length);
+
+  /**
+   * Set the number of already simulated cycles.
+   *
+   * Used to continue a run from a restored snapshot of the model. The state
+   * of a trigger, see `SetTrigger`, is restored from the occurrences seen in
+   * an earlier run, later occurrences are taken from the same run instead of
+   * the signal.
+   */
+  void SetCycle(uint64_t cycle);
+
+  /**
+   * Get the number of simulated cycles.
+   */
+  uint64_t Cycle() const { return cycle_count_; }
 
   /**
    * Parse command line argument and set the internal variables to the values
@@ -78,10 +118,38 @@ class FaultInjection {
   /**
    * Get the number of iterations extracted from parsed arguments.
    */
-  unsigned int IterationLength();
+  uint64_t IterationLength();
+
+  /**
+   * Get the first iteration number extracted from parsed arguments.
+   *
+   * Non-zero if only a part of the iterations is selected, e.g. to distribute
+   * a campaign over several processes.
+   */
+  uint64_t IterationStart();
+
+  /**
+   * Get the socket path of the daemon mode, empty if not selected.
+   */
+  const std::string &DaemonSocket() const { return daemon_socket_; }
+
+  /**
+   * Get the file of the stored parallel configurations, empty if the
+   * iterations should be run sequentially.
+   */
+  const std::string &TuningFile() const { return tuning_file_; }
+
+  /**
+   * Get the corpus file of a coverage-guided campaign, empty if the faults
+   * are selected from the fault space directly.
+   */
+  const std::string &CorpusFile() const { return corpus_file_; }
 
   /**
    * Return the config and the accumulated log.
+   *
+   * The events of the run are only formatted here, the simulation itself
+   * only stores binary records, see `Events()`.
    */
   friend std::ostream &operator<<(std::ostream &os, const FaultInjection &f);
 
@@ -95,6 +163,82 @@ class FaultInjection {
   template <typename T>
   bool UpdateInsert(T *fi);
 
+  /**
+   * Inject relative to a design condition instead of an absolute cycle.
+   *
+   * The fault is inserted `temporal - lead` cycles after the `occurrence`-th
+   * cycle in which `signal` changed and met `predicate`, e.g. the n-th entry
+   * into a state or an edge of a signal. The temporal values of the fault
+   * space are then offsets, so `-z` selects a small window around the trigger.
+   *
+   * The trigger is evaluated in `UpdateInsert` with the shadow comparison of
+   * `AbortWatchList` until it fired. Faults before the trigger (offset below
+   * `lead`) use the trigger cycle of an earlier run, the prefix of a run is
+   * identical up to the fault. If the trigger was not seen before, such a run
+   * only records the trigger cycle and injects nothing.
+   */
+  template <typename T>
+  void SetTrigger(const char *name, T *signal, const AbortPredicate &predicate,
+                  uint64_t occurrence = 1, uint64_t lead = 0) {
+    trigger_ = AbortWatchList();
+    trigger_.Add(name, signal, predicate, 0);
+    trigger_occurrence_ = occurrence ? occurrence : 1;
+    trigger_lead_ = lead;
+    trigger_history_.clear();
+    trigger_history_.reserve(trigger_occurrence_);
+    trigger_count_ = 0;
+    trigger_cycle_ = 0;
+    trigger_replay_ = false;
+  }
+
+  /**
+   * Return the cycle in which the trigger fired, 0 if it did not fire yet.
+   */
+  uint64_t TriggerCycle() const { return trigger_cycle_; }
+
+  /**
+   * Return the absolute cycle of the active fault, 0 if it depends on a
+   * trigger which was not seen yet.
+   */
+  uint64_t InjectionCycle() const;
+
+  /**
+   * Register the fault control side-band of a memory, see `addFi -mem`.
+   *
+   * `offset` is the position of the side-band in the memory fault bus
+   * (`fi_mem_combined`). The side-band consists of the address, the bit index
+   * and the enable signal, starting at the least significant bit. Returns the
+   * identifier of the memory.
+   */
+  size_t AddMemory(const char *name, unsigned int offset,
+                   unsigned int addr_bits, unsigned int bit_bits);
+
+  /**
+   * Invert a bit of a stored word of a memory in the given cycle.
+   *
+   * The memory is written with the next active clock edge of the memory.
+   * Scheduled flips belong to the current run, `UpdateSpace` removes them, so
+   * they must be scheduled after `UpdateSpace`.
+   */
+  void ScheduleMemoryFlip(size_t memory, uint64_t cycle, uint64_t address,
+                          unsigned int bit);
+
+  /**
+   * Drive the memory fault bus for the scheduled memory faults.
+   *
+   * Must be called each clock cycle after `UpdateInsert`, or after
+   * `AdvanceCycle` if the design has no fault injection bus.
+   */
+  template <typename T>
+  bool UpdateMemory(T &fi_mem);
+  template <typename T>
+  bool UpdateMemory(T *fi_mem);
+
+  /**
+   * Count a clock cycle without updating the fault injection bus.
+   */
+  void AdvanceCycle() { cycle_count_++; }
+
   /**
    * Add an abort signal to the watch list.
    *
@@ -106,6 +250,19 @@ class FaultInjection {
   void AddAbortWatch(const char *name, CData *signal, unsigned int delay = 0,
                      bool positive_polarity = true);
 
+  /**
+   * Add an abort signal of any width with a custom condition.
+   *
+   * The signal can be of any Verilator type, including wide signals. The
+   * condition is only evaluated in cycles in which the signal changed, see
+   * `AbortWatchList`.
+   */
+  template <typename T>
+  void AddAbortWatch(const char *name, T *signal,
+                     const AbortPredicate &predicate, unsigned int delay = 0) {
+    abort_watch_list_.Add(name, signal, predicate, delay);
+  }
+
   /**
    * Convey a request to stop the simulation.
    *
@@ -122,16 +279,43 @@ class FaultInjection {
    */
   void AddValueComparator(std::function<bool(std::string &s)> &);
 
+  /**
+   * Add a named design source which reports the matched value.
+   *
+   * In contrast to the string based comparator, no text is created during the
+   * simulation, see `DataMonitor::Match`.
+   */
+  void AddValueComparator(const char *name,
+                          std::function<bool(uint64_t &value)> fs);
+
+  /**
+   * Set the number of events and the bytes of event text stored for a run.
+   *
+   * If more events occur, the newer ones are dropped, texts beyond
+   * `text_capacity` are truncated. Default is 1024 events and 64 KiB of text.
+   */
+  void SetEventCapacity(size_t capacity, size_t text_capacity = 64 * 1024) {
+    events_.Resize(capacity, text_capacity);
+  }
+
+  /**
+   * Return the events of the current run.
+   */
+  const EventBuffer &Events() const { return events_; }
+
   /**
    * Set the duration of an active fault.
    *
    * Number of cycles in which the fault is active (asserted), default is one
    * cycle.
    */
-  void SetFaultDuration(unsigned int length) { injection_duration_ = length; };
+  void SetFaultDuration(unsigned int length) {
+    fault_length_ = length;
+    injection_duration_ = length;
+  };
 
   /**
-   * Check if a fault has been injected.
+   * Check if a fault has been injected, on the bus or as a memory flip.
    */
   bool Injected();
 
@@ -145,26 +329,132 @@ class FaultInjection {
    */
   struct Fault GetFaultSpace();
 
+  /**
+   * Return the space of all faults for the current configuration.
+   */
+  FaultSpace GetFullSpace() const;
+
+  /**
+   * Return the index of the current fault in the space of all faults.
+   *
+   * Only defined for faults within the space, a fault given with `-i` can lie
+   * outside of it.
+   */
+  uint64_t FaultId() const { return GetFullSpace().IndexOf(active_fault_); }
+
+  /**
+   * Return the classification of the current run.
+   *
+   * Only final after the run has ended, i.e. before the next `UpdateSpace`.
+   */
+  FaultOutcome Outcome() const;
+
  private:
   const unsigned int num_fi_signals;
   bool injected_;
   unsigned int injection_duration_;
-  unsigned long cycle_count_;
+  unsigned int fault_length_ = 1;
+  uint64_t cycle_count_;
   struct Fault active_fault_;
-  unsigned long num_iterations_;
+  uint64_t num_iterations_;
+  uint64_t iteration_start_ = 0;
+  uint64_t seed_ = 0;
+  uint64_t schedule_block_ = 0;
+  // Iteration number of the first entry of `schedule_`
+  uint64_t schedule_start_ = 0;
+  std::vector<uint64_t> schedule_;
   bool sequential_ = false;
+  std::string daemon_socket_;
+  std::string tuning_file_;
+  std::string corpus_file_;
   bool inject_specific_ = false;
+  bool abort_detected_ = false;
+  bool data_matched_ = false;
   struct Temporal temporal_limit_;
-  std::vector<struct AbortInfo> abort_watch_list_;
-  std::vector<std::function<bool(std::string &)>> value_compare_list_;
-  std::stringstream log_;
+  AbortWatchList abort_watch_list_;
+  // Injection trigger, disabled if `trigger_occurrence_` is 0
+  AbortWatchList trigger_;
+  uint64_t trigger_occurrence_ = 0;
+  uint64_t trigger_lead_ = 0;
+  uint64_t trigger_count_ = 0;
+  uint64_t trigger_cycle_ = 0;
+  // Cycles of the occurrences up to the trigger, from the first run which
+  // reached it
+  std::vector<uint64_t> trigger_history_;
+  // The fault was before the trigger, which was not known in advance
+  bool trigger_missed_ = false;
+  // The run continues from a snapshot, occurrences come from the history
+  bool trigger_replay_ = false;
+  struct ValueComparator {
+    std::string name;
+    std::function<bool(uint64_t &)> match;
+    std::function<bool(std::string &)> compare;
+    // Text of a string based comparator, reused to avoid allocations
+    std::string text;
+  };
+  std::vector<struct ValueComparator> value_compare_list_;
+  EventBuffer events_;
+  struct MemoryInfo {
+    std::string name;
+    unsigned int offset;
+    unsigned int addr_bits;
+    unsigned int bit_bits;
+  };
+  struct MemoryFlip {
+    size_t memory;
+    uint64_t cycle;
+    uint64_t address;
+    unsigned int bit;
+  };
+  std::vector<struct MemoryInfo> memories_;
+  std::vector<struct MemoryFlip> memory_flips_;
+  // A memory side-band was enabled in the last cycle
+  bool memory_active_ = false;
+  // A memory flip was applied, kept apart from `injected_` which controls the
+  // fault injection bus
+  bool memory_injected_ = false;
+
+  template <typename F>
+  bool UpdateMemoryBits(F set_bit);
+
+  /**
+   * Check if the active fault must be inserted in the current cycle.
+   */
+  bool InjectionDue();
+
+  /**
+   * Reset the state of the last run.
+   */
+  void ResetRun();
 
   /**
    * Sets the fault based on the configuration.
    */
-  void SetFaultRange(unsigned long int iteration_count = 0);
+  void SetFaultRange(uint64_t iteration_count = 0);
 };
 
+/**
+ * Set a bit of a fault injection bus with a width < 65.
+ */
+template <typename T>
+void SetFaultBit(T &bus, uint64_t pos, bool value) {
+  if (pos >= sizeof(T) * 8) {
+    return;
+  }
+  const T mask = ((T)0x1) << pos;
+  bus = value ? (bus | mask) : (bus & ~mask);
+}
+
+/**
+ * Set a bit of a fault injection bus with a width > 64, handled as 32-bit
+ * array.
+ */
+template <typename T>
+void SetFaultBit(T *bus, uint64_t pos, bool value) {
+  const T mask = 0x1U << (pos % 32);
+  bus[pos / 32] = value ? (bus[pos / 32] | mask) : (bus[pos / 32] & ~mask);
+}
+
 // TODO: make fault active length variable
 
 /* Fault injection for signals with a width < 65 */
@@ -179,11 +469,10 @@ bool FaultInjection::UpdateInsert(T &fi_signal) {
       return true;
     }
   }
-  if (cycle_count_ >= active_fault_.temporal) {
+  if (InjectionDue()) {
     fi_signal = ((T)0x1) << active_fault_.spatial;
     injected_ = true;
-    log_ << cycle_count_ << "\t" << active_fault_ << "\t"
-         << "Fault inserted" << std::endl;
+    events_.Push(Event{cycle_count_, active_fault_, 0, EventKind::kInserted, 0});
     return true;
   }
   return false;
@@ -202,14 +491,61 @@ bool FaultInjection::UpdateInsert(T *fi_signal) {
       return true;
     }
   }
-  if (cycle_count_ >= active_fault_.temporal) {
-    fi_signal[active_fault_.spatial / 32] = 0x1 << (active_fault_.spatial % 32);
+  if (InjectionDue()) {
+    fi_signal[active_fault_.spatial / 32] = 0x1U << (active_fault_.spatial % 32);
     injected_ = true;
-    log_ << cycle_count_ << "\t" << active_fault_ << "\t"
-         << "Fault inserted" << std::endl;
+    events_.Push(Event{cycle_count_, active_fault_, 0, EventKind::kInserted, 0});
     return true;
   }
   return false;
 }
 
+template <typename F>
+bool FaultInjection::UpdateMemoryBits(F set_bit) {
+  // Disable the faults of the last cycle
+  if (memory_active_) {
+    for (auto &m : memories_) {
+      set_bit(m.offset + m.addr_bits + m.bit_bits, false);
+    }
+    memory_active_ = false;
+  }
+  bool applied = false;
+  for (auto &f : memory_flips_) {
+    if (f.cycle != cycle_count_) {
+      continue;
+    }
+    const struct MemoryInfo &m = memories_[f.memory];
+    for (unsigned int i = 0; i < m.addr_bits; ++i) {
+      set_bit(m.offset + i, (f.address >> i) & 1);
+    }
+    for (unsigned int i = 0; i < m.bit_bits; ++i) {
+      set_bit(m.offset + m.addr_bits + i, (f.bit >> i) & 1);
+    }
+    set_bit(m.offset + m.addr_bits + m.bit_bits, true);
+    memory_active_ = true;
+    memory_injected_ = true;
+    applied = true;
+    events_.Push(Event{cycle_count_, Fault{f.cycle, f.bit}, f.address,
+                       EventKind::kMemoryFlip,
+                       static_cast<uint16_t>(f.memory)});
+  }
+  return applied;
+}
+
+/* Memory fault bus with a width < 65 */
+template <typename T>
+bool FaultInjection::UpdateMemory(T &fi_mem) {
+  return UpdateMemoryBits([&fi_mem](unsigned int pos, bool value) {
+    SetFaultBit(fi_mem, pos, value);
+  });
+}
+
+/* Memory fault bus with a width > 64, handled as 32-bit array */
+template <typename T>
+bool FaultInjection::UpdateMemory(T *fi_mem) {
+  return UpdateMemoryBits([fi_mem](unsigned int pos, bool value) {
+    SetFaultBit(fi_mem, pos, value);
+  });
+}
+
 #endif  // FAULT_INJECTION_H_
@@ -0,0 +1,136 @@
+#include "fault_space.h"
+
+#include <limits>
+
+namespace {
+
+// Finalizer of SplitMix64, a fast 64-bit mixing function.
+uint64_t Mix(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+}  // namespace
+
+FaultSpace::FaultSpace(uint64_t temporal_start, uint64_t temporal_duration,
+                       uint64_t spatial_width, uint64_t seed)
+    : temporal_start_(temporal_start),
+      spatial_width_(spatial_width ? spatial_width : 1),
+      size_(temporal_duration * spatial_width_),
+      half_bits_(0) {
+  // Saturate instead of wrapping around if the space has more than 2^64 faults
+  const uint64_t max_duration =
+      std::numeric_limits<uint64_t>::max() / spatial_width_;
+  if (temporal_duration > max_duration) {
+    size_ = max_duration * spatial_width_;
+  }
+  // Smallest even number of bits covering the space
+  while (half_bits_ < 32 && (size_ - 1) >> (2 * half_bits_)) {
+    half_bits_++;
+  }
+  half_mask_ = half_bits_ < 32 ? (1ULL << half_bits_) - 1 : 0xffffffffULL;
+  SetSeed(seed);
+}
+
+void FaultSpace::SetSeed(uint64_t seed) {
+  for (unsigned int i = 0; i < kRounds; ++i) {
+    keys_[i] = Mix(seed + i);
+  }
+}
+
+struct Fault FaultSpace::At(uint64_t index) const {
+  return Fault{index / spatial_width_ + temporal_start_,
+               index % spatial_width_};
+}
+
+uint64_t FaultSpace::IndexOf(const struct Fault &f) const {
+  return (f.temporal - temporal_start_) * spatial_width_ + f.spatial;
+}
+
+bool FaultSpace::Contains(const struct Fault &f) const {
+  return f.temporal >= temporal_start_ && f.spatial < spatial_width_ &&
+         IndexOf(f) < size_;
+}
+
+uint64_t FaultSpace::Feistel(uint64_t value) const {
+  uint64_t left = value >> half_bits_;
+  uint64_t right = value & half_mask_;
+  for (unsigned int i = 0; i < kRounds; ++i) {
+    uint64_t next = left ^ (Mix(right ^ keys_[i]) & half_mask_);
+    left = right;
+    right = next;
+  }
+  return (left << half_bits_) | right;
+}
+
+uint64_t FaultSpace::InverseFeistel(uint64_t value) const {
+  uint64_t left = value >> half_bits_;
+  uint64_t right = value & half_mask_;
+  for (unsigned int i = kRounds; i-- > 0;) {
+    uint64_t previous = right ^ (Mix(left ^ keys_[i]) & half_mask_);
+    right = left;
+    left = previous;
+  }
+  return (left << half_bits_) | right;
+}
+
+uint64_t FaultSpace::Permute(uint64_t index) const {
+  if (size_ <= 1) {
+    return 0;
+  }
+  // The Feistel network is a bijection on [0, 2^(2*half_bits_)), which is at
+  // most four times the size of the space. Applying it until the value falls
+  // into the space (cycle walking) keeps the mapping bijective.
+  uint64_t value = index % size_;
+  do {
+    value = Feistel(value);
+  } while (value >= size_);
+  return value;
+}
+
+uint64_t FaultSpace::Unpermute(uint64_t index) const {
+  if (size_ <= 1) {
+    return 0;
+  }
+  // Walk the cycle backwards
+  uint64_t value = index % size_;
+  do {
+    value = InverseFeistel(value);
+  } while (value >= size_);
+  return value;
+}
+
+std::vector<struct FaultSpace::Range> FaultSpace::Split(
+    unsigned int parts) const {
+  return SplitRange(0, size_, parts);
+}
+
+std::vector<struct FaultSpace::Range> FaultSpace::SplitRange(
+    uint64_t begin, uint64_t end, unsigned int parts) {
+  std::vector<struct Range> ranges;
+  if (!parts || end < begin) {
+    return ranges;
+  }
+  for (unsigned int i = 0; i < parts; ++i) {
+    ranges.push_back(RangeAt(begin, end, parts, i));
+  }
+  return ranges;
+}
+
+struct FaultSpace::Range FaultSpace::RangeAt(uint64_t begin, uint64_t end,
+                                             uint64_t parts, uint64_t part) {
+  const uint64_t length = end - begin;
+  const uint64_t chunk = length / parts;
+  const uint64_t remainder = length % parts;
+  // The first `remainder` ranges are one element longer
+  uint64_t start =
+      begin + part * chunk + (part < remainder ? part : remainder);
+  return Range{start, start + chunk + (part < remainder ? 1 : 0)};
+}
+
+std::ostream &operator<<(std::ostream &os, const struct Fault &f) {
+  os << f.temporal << "," << f.spatial;
+  return os;
+}
@@ -0,0 +1,117 @@
+#ifndef FAULT_SPACE_H_
+#define FAULT_SPACE_H_
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+struct Fault {
+  uint64_t temporal;
+  uint64_t spatial;
+  friend std::ostream &operator<<(std::ostream &os, const struct Fault &f);
+};
+
+/**
+ * Enumeration of all faults within a temporal window and a fault bus.
+ *
+ * The space is never materialized. Every fault is addressed by a 64-bit index,
+ * the temporal value changes with low frequency and the spatial value with
+ * high frequency: index = (temporal - start) * width + spatial.
+ */
+class FaultSpace {
+ public:
+  struct Range {
+    uint64_t begin;
+    uint64_t end;
+  };
+
+  /**
+   * The temporal window is shortened to the cycles whose faults can be
+   * addressed by a 64-bit index.
+   */
+  FaultSpace(uint64_t temporal_start, uint64_t temporal_duration,
+             uint64_t spatial_width, uint64_t seed = 0);
+
+  /**
+   * Number of faults in the space.
+   */
+  uint64_t Size() const { return size_; }
+
+  /**
+   * Get the fault of an index in sequential order.
+   *
+   * Indices beyond `Size()` are not wrapped, they continue with the cycles
+   * after the temporal window.
+   */
+  struct Fault At(uint64_t index) const;
+
+  /**
+   * Get the index of a fault in sequential order.
+   */
+  uint64_t IndexOf(const struct Fault &f) const;
+
+  /**
+   * Check if a fault lies within the temporal window and the fault bus.
+   */
+  bool Contains(const struct Fault &f) const;
+
+  /**
+   * Map an index to a pseudo-random index of the space.
+   *
+   * The mapping is a bijection on [0, Size()) which only depends on the seed.
+   * Iterating over consecutive indices therefore samples the space randomly
+   * without replacement. Indices beyond `Size()` are wrapped.
+   */
+  uint64_t Permute(uint64_t index) const;
+
+  /**
+   * Inverse of `Permute`, the position of an index in the pseudo-random
+   * order.
+   */
+  uint64_t Unpermute(uint64_t index) const;
+
+  /**
+   * Get the fault of an index in pseudo-random order.
+   */
+  struct Fault RandomAt(uint64_t index) const { return At(Permute(index)); }
+
+  /**
+   * Change the seed of the pseudo-random order.
+   */
+  void SetSeed(uint64_t seed);
+
+  /**
+   * Split the space into `parts` consecutive ranges of nearly equal size.
+   */
+  std::vector<struct Range> Split(unsigned int parts) const;
+
+  /**
+   * Split [begin, end) into `parts` consecutive ranges of nearly equal size.
+   */
+  static std::vector<struct Range> SplitRange(uint64_t begin, uint64_t end,
+                                              unsigned int parts);
+
+  /**
+   * Get the `part`-th range of `SplitRange` without creating the others.
+   *
+   * `part` must be less than `parts`.
+   */
+  static struct Range RangeAt(uint64_t begin, uint64_t end, uint64_t parts,
+                              uint64_t part);
+
+ private:
+  static const unsigned int kRounds = 6;
+
+  uint64_t temporal_start_;
+  uint64_t spatial_width_;
+  uint64_t size_;
+  // Number of bits of each half of the Feistel network
+  unsigned int half_bits_;
+  uint64_t half_mask_;
+  uint64_t keys_[kRounds];
+
+  uint64_t Feistel(uint64_t value) const;
+  uint64_t InverseFeistel(uint64_t value) const;
+};
+
+#endif  // FAULT_SPACE_H_
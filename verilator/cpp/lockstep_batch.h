@@ -0,0 +1,257 @@
+#ifndef LOCKSTEP_BATCH_H_
+#define LOCKSTEP_BATCH_H_
+
+#include <verilated.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "checkpoint_ladder.h"
+#include "fault_injection.h"
+#include "fault_space.h"
+
+/**
+ * Simulate many faulty instances of a model in lockstep on a single thread.
+ *
+ * The batch owns `lanes` instances of the model and one golden instance. All
+ * lanes are advanced cycle by cycle in the same loop, so the model code and the
+ * harness stay in the caches. A lane whose run finished is refilled with the
+ * next fault right away by restoring the state the golden instance had after
+ * `H::Reset`; models are constructed once. The model must be verilated with
+ * `--savable`.
+ *
+ * The fault state of the lanes is kept as a structure of arrays. The outputs
+ * of the golden instance are recorded once per cycle, every lane compares its
+ * outputs against the recording of its own cycle.
+ *
+ * The harness `H` provides:
+ *   void Reset(M &model, VerilatedContext &context);
+ *     Drive the model into the state of cycle 0.
+ *   void Step(M &model, VerilatedContext &context);
+ *     Simulate one clock cycle.
+ *   void SetFault(M &model, uint64_t spatial, bool active);
+ *     Drive a bit of the fault injection bus, see `SetFaultBit`.
+ *   uint64_t Observe(M &model);
+ *     Hash of the outputs compared against the golden instance.
+ *   bool Abort(M &model);
+ *     An abort signal is asserted, e.g. an alert was raised. The run ends
+ *     `abort_delay` cycles later, like a watch added with `AddAbortWatch`.
+ *   bool Leak(M &model, uint64_t &value);
+ *     Data of interest is visible, counted as `FaultOutcome::kDataMatch`.
+ */
+template <typename M, typename H>
+class LockstepBatch {
+ public:
+  struct Result {
+    uint64_t job;
+    struct Fault fault;
+    FaultOutcome outcome;
+    // First cycle in which the outputs differed from the golden run, 0 if not
+    uint64_t divergence;
+    uint64_t cycles;
+  };
+
+  /**
+   * Create `lanes` faulty instances, each run lasts at most `max_cycles`
+   * cycles and a fault is active for `fault_length` cycles. A run is stopped
+   * `abort_delay` cycles after `H::Abort` first returned true.
+   */
+  LockstepBatch(H &harness, unsigned int lanes, uint64_t max_cycles,
+                unsigned int fault_length = 1, unsigned int abort_delay = 0);
+  ~LockstepBatch();
+
+  /**
+   * Simulate faults until `next` returns false.
+   *
+   * `next(struct Fault &fault, uint64_t &job)` provides the next fault and an
+   * identifier passed back with the result. `done(const Result &r)` is called
+   * for each finished run. Returns the number of runs.
+   */
+  template <typename S, typename D>
+  uint64_t Run(S next, D done);
+
+  unsigned int Lanes() const { return static_cast<unsigned int>(lanes_); }
+
+ private:
+  enum LaneState : uint8_t { kIdle, kWaiting, kActive, kInjected };
+
+  H &harness_;
+  const size_t lanes_;
+  const uint64_t max_cycles_;
+  const unsigned int fault_length_;
+  const unsigned int abort_delay_;
+  std::vector<std::unique_ptr<VerilatedContext>> contexts_;
+  std::vector<std::unique_ptr<M>> models_;
+  std::unique_ptr<VerilatedContext> golden_context_;
+  std::unique_ptr<M> golden_;
+  // Outputs of the golden instance, index 0 is cycle 1
+  std::vector<uint64_t> golden_trace_;
+  // State after `H::Reset`, restored into a lane for each run
+  std::vector<uint8_t> reset_state_;
+  uint64_t reset_time_ = 0;
+
+  // Fault state of the lanes
+  std::vector<uint8_t> state_;
+  std::vector<uint64_t> job_;
+  std::vector<uint64_t> temporal_;
+  std::vector<uint64_t> spatial_;
+  std::vector<uint64_t> cycle_;
+  std::vector<unsigned int> remaining_;
+  std::vector<uint64_t> divergence_;
+  std::vector<uint8_t> leaked_;
+  // Cycles until the stop of an asserted abort, kNoAbort if not asserted
+  std::vector<unsigned int> abort_count_;
+  static const unsigned int kNoAbort = static_cast<unsigned int>(-1);
+
+  void Load(size_t lane, const struct Fault &f, uint64_t job);
+  struct Result Finish(size_t lane, FaultOutcome outcome);
+  uint64_t Golden(uint64_t cycle);
+};
+
+template <typename M, typename H>
+const unsigned int LockstepBatch<M, H>::kNoAbort;
+
+template <typename M, typename H>
+LockstepBatch<M, H>::LockstepBatch(H &harness, unsigned int lanes,
+                                   uint64_t max_cycles,
+                                   unsigned int fault_length,
+                                   unsigned int abort_delay)
+    : harness_(harness),
+      lanes_(lanes ? lanes : 1),
+      max_cycles_(max_cycles),
+      fault_length_(fault_length ? fault_length : 1),
+      abort_delay_(abort_delay),
+      golden_context_(new VerilatedContext),
+      golden_(new M{golden_context_.get(), "TOP"}),
+      state_(lanes_, kIdle),
+      job_(lanes_, 0),
+      temporal_(lanes_, 0),
+      spatial_(lanes_, 0),
+      cycle_(lanes_, 0),
+      remaining_(lanes_, 0),
+      divergence_(lanes_, 0),
+      leaked_(lanes_, 0),
+      abort_count_(lanes_, kNoAbort) {
+  for (size_t l = 0; l < lanes_; ++l) {
+    contexts_.emplace_back(new VerilatedContext);
+    models_.emplace_back(new M{contexts_.back().get(), "TOP"});
+  }
+  harness_.Reset(*golden_, *golden_context_);
+  {
+    MemorySerialize os(&reset_state_);
+    os << *golden_;
+  }
+  reset_time_ = golden_context_->time();
+  golden_trace_.reserve(max_cycles_);
+}
+
+template <typename M, typename H>
+LockstepBatch<M, H>::~LockstepBatch() {
+  for (auto &m : models_) {
+    m->final();
+  }
+  golden_->final();
+}
+
+template <typename M, typename H>
+void LockstepBatch<M, H>::Load(size_t lane, const struct Fault &f,
+                               uint64_t job) {
+  MemoryDeserialize os(reset_state_.data(), reset_state_.size());
+  os >> *models_[lane];
+  contexts_[lane]->time(reset_time_);
+  state_[lane] = kWaiting;
+  job_[lane] = job;
+  temporal_[lane] = f.temporal;
+  spatial_[lane] = f.spatial;
+  cycle_[lane] = 0;
+  divergence_[lane] = 0;
+  leaked_[lane] = 0;
+  abort_count_[lane] = kNoAbort;
+}
+
+template <typename M, typename H>
+struct LockstepBatch<M, H>::Result LockstepBatch<M, H>::Finish(
+    size_t lane, FaultOutcome outcome) {
+  if (state_[lane] == kWaiting) {
+    outcome = FaultOutcome::kNotInjected;
+  } else if (leaked_[lane]) {
+    outcome = FaultOutcome::kDataMatch;
+  }
+  state_[lane] = kIdle;
+  return Result{job_[lane], Fault{temporal_[lane], spatial_[lane]}, outcome,
+                divergence_[lane], cycle_[lane]};
+}
+
+template <typename M, typename H>
+uint64_t LockstepBatch<M, H>::Golden(uint64_t cycle) {
+  while (golden_trace_.size() < cycle) {
+    harness_.Step(*golden_, *golden_context_);
+    golden_trace_.push_back(harness_.Observe(*golden_));
+  }
+  return golden_trace_[cycle - 1];
+}
+
+template <typename M, typename H>
+template <typename S, typename D>
+uint64_t LockstepBatch<M, H>::Run(S next, D done) {
+  uint64_t runs = 0;
+  bool exhausted = false;
+  size_t busy;
+  do {
+    busy = 0;
+    for (size_t l = 0; l < lanes_; ++l) {
+      if (state_[l] == kIdle) {
+        struct Fault f;
+        uint64_t job;
+        if (exhausted || !next(f, job)) {
+          exhausted = true;
+          continue;
+        }
+        Load(l, f, job);
+      }
+      busy++;
+      M &m = *models_[l];
+      const uint64_t c = ++cycle_[l];
+      // Same timing as `FaultInjection::UpdateInsert`
+      if (state_[l] == kWaiting && c >= temporal_[l]) {
+        harness_.SetFault(m, spatial_[l], true);
+        state_[l] = kActive;
+        remaining_[l] = fault_length_;
+      } else if (state_[l] == kActive && --remaining_[l] == 0) {
+        harness_.SetFault(m, spatial_[l], false);
+        state_[l] = kInjected;
+      }
+      harness_.Step(m, *contexts_[l]);
+      if (!divergence_[l] && harness_.Observe(m) != Golden(c)) {
+        divergence_[l] = c;
+      }
+      // Only check after the fault is inserted, in the order of
+      // `FaultInjection::StopRequested`
+      if (state_[l] != kWaiting) {
+        if (abort_count_[l] == kNoAbort && harness_.Abort(m)) {
+          abort_count_[l] = abort_delay_;
+        }
+        if (abort_count_[l] == 0) {
+          done(Finish(l, FaultOutcome::kAbort));
+          runs++;
+          continue;
+        }
+        if (abort_count_[l] != kNoAbort) {
+          abort_count_[l]--;
+        }
+        uint64_t value;
+        if (harness_.Leak(m, value)) {
+          leaked_[l] = 1;
+        }
+      }
+      if (c >= max_cycles_) {
+        done(Finish(l, FaultOutcome::kNoEffect));
+        runs++;
+      }
+    }
+  } while (busy);
+  return runs;
+}
+
+#endif  // LOCKSTEP_BATCH_H_
@@ -0,0 +1,216 @@
+#include "parallel_tuner.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace {
+
+// Parse a Linux CPU list, e.g. "0-3,8-11"
+std::vector<int> ParseCpuList(const std::string &list) {
+  std::vector<int> cpus;
+  std::istringstream iss(list);
+  std::string range;
+  while (std::getline(iss, range, ',')) {
+    size_t dash = range.find('-');
+    try {
+      int first = std::stoi(range.substr(0, dash));
+      int last =
+          dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+      for (int c = first; c <= last; ++c) {
+        cpus.push_back(c);
+      }
+    } catch (const std::exception &) {
+      // Ignore malformed entries
+    }
+  }
+  return cpus;
+}
+
+void PinThread(const std::vector<int> &cpus) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int c : cpus) {
+    CPU_SET(c, &set);
+  }
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+}  // namespace
+
+ParallelTuner::ParallelTuner(RunFunction run, unsigned int max_model_threads,
+                             unsigned int cores)
+    : run_(run), max_model_threads_(max_model_threads ? max_model_threads : 1) {
+  DetectCores(cores);
+}
+
+void ParallelTuner::DetectCores(unsigned int limit) {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    for (unsigned int c = 0; c < std::thread::hardware_concurrency(); ++c) {
+      CPU_SET(c, &allowed);
+    }
+  }
+  std::vector<bool> used(CPU_SETSIZE, false);
+  // Cores of each NUMA node
+  for (int node = 0;; ++node) {
+    std::ifstream f("/sys/devices/system/node/node" + std::to_string(node) +
+                    "/cpulist");
+    if (!f) {
+      break;
+    }
+    std::string list;
+    std::getline(f, list);
+    for (int c : ParseCpuList(list)) {
+      if (c >= 0 && c < CPU_SETSIZE && CPU_ISSET(c, &allowed) && !used[c]) {
+        cores_.push_back(c);
+        used[c] = true;
+      }
+    }
+  }
+  // Without NUMA information take all allowed cores in order
+  for (int c = 0; c < CPU_SETSIZE; ++c) {
+    if (CPU_ISSET(c, &allowed) && !used[c]) {
+      cores_.push_back(c);
+    }
+  }
+  if (limit && limit < cores_.size()) {
+    cores_.resize(limit);
+  }
+  if (cores_.empty()) {
+    cores_.push_back(0);
+  }
+}
+
+std::vector<struct ParallelConfig> ParallelTuner::Candidates() const {
+  std::vector<struct ParallelConfig> candidates;
+  const unsigned int cores = cores_.size();
+  const unsigned int max_threads =
+      max_model_threads_ < cores ? max_model_threads_ : cores;
+  // Powers of two and the number of threads the model was verilated with
+  std::vector<unsigned int> threads;
+  for (unsigned int t = 1; t < max_threads; t *= 2) {
+    threads.push_back(t);
+  }
+  threads.push_back(max_threads);
+  for (unsigned int t : threads) {
+    for (unsigned int runs = cores / t; runs; runs /= 2) {
+      candidates.push_back(ParallelConfig{t, runs, 0.0});
+    }
+  }
+  return candidates;
+}
+
+struct ParallelConfig ParallelTuner::Calibrate(unsigned int runs_per_config,
+                                               uint64_t first) {
+  return Calibrate(Candidates(), runs_per_config, first);
+}
+
+struct ParallelConfig ParallelTuner::Calibrate(
+    const std::vector<struct ParallelConfig> &candidates,
+    unsigned int runs_per_config, uint64_t first) {
+  results_ = candidates;
+  if (results_.empty()) {
+    results_.push_back(ParallelConfig{1, 1, 0.0});
+  }
+  struct ParallelConfig best = results_.front();
+  for (auto &c : results_) {
+    // Each worker runs at least one iteration
+    uint64_t runs = runs_per_config > c.concurrent_runs ? runs_per_config
+                                                         : c.concurrent_runs;
+    auto start = std::chrono::steady_clock::now();
+    // The run without a fault first, then the faulty runs
+    Run(c, runs + 1, [first](uint64_t i) {
+      return i ? first + i - 1 : kGoldenRun;
+    });
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    c.faults_per_second = (runs + 1) / elapsed.count();
+    if (c.faults_per_second > best.faults_per_second) {
+      best = c;
+    }
+  }
+  return best;
+}
+
+void ParallelTuner::Run(const struct ParallelConfig &config, uint64_t begin,
+                        uint64_t end) {
+  if (end > begin) {
+    Run(config, end - begin, [begin](uint64_t i) { return begin + i; });
+  }
+}
+
+void ParallelTuner::Run(const struct ParallelConfig &config, uint64_t count,
+                        const std::function<uint64_t(uint64_t)> &iteration) {
+  std::atomic<uint64_t> next(0);
+  std::vector<std::thread> workers;
+  const unsigned int threads = config.model_threads ? config.model_threads : 1;
+  for (unsigned int w = 0; w < config.concurrent_runs; ++w) {
+    std::vector<int> cpus;
+    for (unsigned int t = 0; t < threads; ++t) {
+      cpus.push_back(cores_[(w * threads + t) % cores_.size()]);
+    }
+    workers.emplace_back([this, cpus, threads, count, &iteration, &next]() {
+      PinThread(cpus);
+      for (uint64_t i = next++; i < count; i = next++) {
+        run_(threads, iteration(i));
+      }
+    });
+  }
+  for (auto &w : workers) {
+    w.join();
+  }
+}
+
+bool ParallelTuner::Load(const std::string &filename, const std::string &key,
+                         struct ParallelConfig &config) {
+  std::ifstream f(filename);
+  std::string line;
+  while (std::getline(f, line)) {
+    std::istringstream iss(line);
+    std::string k;
+    struct ParallelConfig c;
+    if (iss >> k >> c.model_threads >> c.concurrent_runs >>
+            c.faults_per_second &&
+        k == key) {
+      config = c;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ParallelTuner::Store(const std::string &filename, const std::string &key,
+                          const struct ParallelConfig &config) {
+  // Keep the entries of other models
+  std::vector<std::string> lines;
+  {
+    std::ifstream f(filename);
+    std::string line;
+    while (std::getline(f, line)) {
+      std::istringstream iss(line);
+      std::string k;
+      if (iss >> k && k != key) {
+        lines.push_back(line);
+      }
+    }
+  }
+  std::ofstream f(filename, std::ios::trunc);
+  if (!f) {
+    return false;
+  }
+  for (auto &l : lines) {
+    f << l << "\n";
+  }
+  f << key << " " << config.model_threads << " " << config.concurrent_runs
+    << " " << config.faults_per_second << "\n";
+  return f.good();
+}
@@ -0,0 +1,109 @@
+#ifndef PARALLEL_TUNER_H_
+#define PARALLEL_TUNER_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Partitioning of the host into threads per model and concurrent runs.
+ */
+struct ParallelConfig {
+  unsigned int model_threads;
+  unsigned int concurrent_runs;
+  double faults_per_second;
+};
+
+/**
+ * Select between intra-model threading (Verilator `--threads`) and running
+ * several single-threaded models in parallel.
+ *
+ * The run function simulates a single iteration of the campaign with a model
+ * using the given number of threads, e.g. by setting
+ * `VerilatedContext::threads()` before creating the model. This needs
+ * Verilator 5, older versions always use the threads given to `--threads`, so
+ * `max_model_threads` should be 1. The run function is called concurrently
+ * from several threads, each thread must use its own `FaultInjection`
+ * instance.
+ *
+ * Each worker thread is pinned to its own set of cores. The sets are assigned
+ * in the order of the NUMA nodes, so a model does not span several nodes if it
+ * fits into one. Threads created by the model inherit the pinning.
+ */
+class ParallelTuner {
+ public:
+  typedef std::function<void(unsigned int model_threads, uint64_t iteration)>
+      RunFunction;
+
+  /**
+   * Iteration passed to the run function for a run without a fault.
+   *
+   * Faulty runs often stop early, the run without a fault simulates the whole
+   * test and is part of every calibration.
+   */
+  static const uint64_t kGoldenRun = ~0ULL;
+
+  /**
+   * `max_model_threads` is the number of threads the model was verilated
+   * with. If `cores` is 0, all cores available to the process are used.
+   */
+  ParallelTuner(RunFunction run, unsigned int max_model_threads,
+                unsigned int cores = 0);
+
+  /**
+   * Configurations with a power of two or all model threads, each with all
+   * cores or a power of two fraction of the parallel runs. Memory bound models
+   * can be faster with fewer runs than cores.
+   */
+  std::vector<struct ParallelConfig> Candidates() const;
+
+  /**
+   * Measure the throughput of each candidate with one run without a fault
+   * and `runs_per_config` iterations, starting at iteration `first`, and
+   * return the fastest.
+   */
+  struct ParallelConfig Calibrate(unsigned int runs_per_config,
+                                  uint64_t first = 0);
+  struct ParallelConfig Calibrate(
+      const std::vector<struct ParallelConfig> &candidates,
+      unsigned int runs_per_config, uint64_t first = 0);
+
+  /**
+   * Return the measured configurations of the last calibration.
+   */
+  const std::vector<struct ParallelConfig> &Results() const {
+    return results_;
+  }
+
+  /**
+   * Run the iterations [begin, end) with the given configuration.
+   */
+  void Run(const struct ParallelConfig &config, uint64_t begin, uint64_t end);
+
+  /**
+   * Read the configuration stored for `key`, e.g. the name of the model.
+   */
+  static bool Load(const std::string &filename, const std::string &key,
+                   struct ParallelConfig &config);
+
+  /**
+   * Store the configuration for `key`, replacing an older entry.
+   */
+  static bool Store(const std::string &filename, const std::string &key,
+                    const struct ParallelConfig &config);
+
+ private:
+  RunFunction run_;
+  unsigned int max_model_threads_;
+  // Usable cores, ordered by NUMA node
+  std::vector<int> cores_;
+  std::vector<struct ParallelConfig> results_;
+
+  void DetectCores(unsigned int limit);
+  // Run `count` iterations, the i-th iteration is `iteration(i)`
+  void Run(const struct ParallelConfig &config, uint64_t count,
+           const std::function<uint64_t(uint64_t)> &iteration);
+};
+
+#endif  // PARALLEL_TUNER_H_
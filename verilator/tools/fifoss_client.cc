@@ -0,0 +1,125 @@
+#include <getopt.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+/*
+ * Send requests to a fault injection daemon, see `CampaignDaemon`.
+ *
+ * Requests are taken from the command line, one per argument, or from the
+ * standard input. The responses are printed as they arrive.
+ */
+
+namespace {
+
+bool SendAll(int fd, const std::string &s) {
+  size_t sent = 0;
+  while (sent < s.size()) {
+    ssize_t n = send(fd, s.data() + sent, s.size() - sent, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
+
+// Print the response lines until the end of the request, returns false on an
+// error response or a closed connection
+bool ReadResponse(int fd, std::string &pending) {
+  char buffer[4096];
+  while (true) {
+    size_t end;
+    while ((end = pending.find('\n')) != std::string::npos) {
+      std::string line = pending.substr(0, end);
+      pending.erase(0, end + 1);
+      if (line == "ok") {
+        return true;
+      }
+      if (line.compare(0, 6, "error ") == 0) {
+        std::cerr << "ERROR: " << line.substr(6) << std::endl;
+        return false;
+      }
+      std::cout << line << "\n";
+    }
+    ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) {
+      std::cerr << "ERROR: Connection closed." << std::endl;
+      return false;
+    }
+    pending.append(buffer, n);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const struct option long_options[] = {
+      {"socket", required_argument, nullptr, 's'},
+      {"time", no_argument, nullptr, 't'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, no_argument, nullptr, 0}};
+  std::string path = "fifoss.sock";
+  bool show_time = false;
+  int c;
+  while ((c = getopt_long(argc, argv, "s:th", long_options, nullptr)) != -1) {
+    switch (c) {
+      case 's':
+        path = optarg;
+        break;
+      case 't':
+        show_time = true;
+        break;
+      default:
+        std::cout << "Usage: " << argv[0]
+                  << " [-s|--socket=path] [-t|--time] [request...]\n\n"
+                     "Requests are read from the standard input if none are "
+                     "given, e.g. \"run 12 3 log\" or \"batch 0 100\".\n";
+        return c == 'h' ? 0 : -1;
+    }
+  }
+
+  struct sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, reinterpret_cast<struct sockaddr *>(&addr),
+                        sizeof(addr)) != 0) {
+    std::cerr << "ERROR: Can not connect to " << path << ": "
+              << std::strerror(errno) << std::endl;
+    return -1;
+  }
+
+  std::string pending;
+  bool success = true;
+  auto request = [&](const std::string &line) {
+    auto start = std::chrono::steady_clock::now();
+    success = SendAll(fd, line + "\n") && ReadResponse(fd, pending) && success;
+    if (show_time) {
+      std::chrono::duration<double, std::milli> elapsed =
+          std::chrono::steady_clock::now() - start;
+      std::cerr << "# " << line << ": " << elapsed.count() << " ms"
+                << std::endl;
+    }
+  };
+  if (optind < argc) {
+    for (int i = optind; i < argc; ++i) {
+      request(argv[i]);
+    }
+  } else {
+    std::string line;
+    while (std::getline(std::cin, line)) {
+      if (!line.empty()) {
+        request(line);
+      }
+    }
+  }
+  close(fd);
+  return success ? 0 : -1;
+}
@@ -1,6 +1,8 @@
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/mem.h"
 #include <cstddef>
+#include <fstream>
 #include <sys/types.h>
 
 USING_YOSYS_NAMESPACE
@@ -13,7 +15,8 @@ struct AddFi : public Pass {
 	{
 		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
 		log("\n");
-		log("    addFi [-no-ff] [-no-comb] [-no-add-input] [-type <cell>]");
+		log("    addFi [-no-ff] [-no-comb] [-no-add-input] [-type <cell>] [-observe <signals>] [-mem]\n");
+		log("          [-local] [-report <file>]");
 		log("\n");
 		log("Add a fault injection signal to every selected cell and wire the control signal\n");
 		log("to the top-level.\n");
@@ -31,11 +34,353 @@ struct AddFi : public Pass {
 		log("       Specify the type of the inserted fault control cell.\n");
 		log("       Possible values are 'or', 'and' and 'xor' (default).\n");
 		log("\n");
+		log("    -observe <signals>");
+		log("       Only insert fault cells for cells in the transitive fan-in of the given\n");
+		log("       comma-separated wires or ports. Signals of the top-level module are given\n");
+		log("       by name, signals of other modules as <module>/<name>. The fan-in is\n");
+		log("       followed through flip-flops and across the hierarchy. Can be given more\n");
+		log("       than once.\n");
+		log("\n");
+		log("    -mem");
+		log("       Add fault injection to memories without mapping them to flip-flops.\n");
+		log("       Each memory gets a side-band of an address, a bit index and an enable\n");
+		log("       signal. While enabled, the addressed bit of the stored word is inverted\n");
+		log("       with the clock of the first write port. The side-bands of all memories\n");
+		log("       are forwarded to the top-level input 'fi_mem_combined'. Memories with an\n");
+		log("       asynchronous first write port are skipped. With -observe only memories\n");
+		log("       read in the transitive fan-in are changed.\n");
+		log("\n");
+		log("    -local");
+		log("       Connect module instances directly to a single forwarded input per\n");
+		log("       submodule port, named after the submodule and the port, and connect the\n");
+		log("       top-level input without a generator module. This avoids intermediate\n");
+		log("       wires and keeps the modules independent of each other, which reduces the\n");
+		log("       size of the generated design and the build time of Verilator.\n");
+		log("\n");
+		log("    -report <file>");
+		log("       Write the instrumentation overhead to <file>: per module and in total the\n");
+		log("       added cells by type, added wires and ports, the width of the fault bus of\n");
+		log("       the module itself and including its submodules, the same for the memory\n");
+		log("       fault bus of -mem, the forwarding depth below the top-level and the\n");
+		log("       number of cells and evaluated cell output bits before and after. The\n");
+		log("       evaluated bits are an estimate of the simulation cost per cycle, totals\n");
+		log("       are weighted by the number of instances.\n");
+		log("\n");
+	}
+
+	struct Driver {
+		RTLIL::Cell *cell;
+		RTLIL::IdString port;
+		int offset;
+	};
+
+	// Find all cells which can influence at least one of the observation points.
+	pool<RTLIL::Cell*> observe_cone(RTLIL::Design *design, const std::vector<std::string> &observe)
+	{
+		dict<RTLIL::Module*, SigMap> sigmaps;
+		// Cell output driving a signal bit
+		dict<RTLIL::Module*, dict<RTLIL::SigBit, Driver>> drivers;
+		// Input port bits of a module
+		dict<RTLIL::Module*, dict<RTLIL::SigBit, std::vector<std::pair<RTLIL::Wire*, int>>>> input_bits;
+		// Instances of a module, together with the instantiating module
+		dict<RTLIL::Module*, std::vector<std::pair<RTLIL::Module*, RTLIL::Cell*>>> instances;
+
+		for (auto module : design->modules())
+		{
+			SigMap &sigmap = sigmaps[module];
+			sigmap.set(module);
+			for (auto wire : module->wires())
+			{
+				if (wire->port_input) {
+					for (int i = 0; i < wire->width; i++) {
+						input_bits[module][sigmap(RTLIL::SigBit(wire, i))].push_back(std::make_pair(wire, i));
+					}
+				}
+			}
+			for (auto cell : module->cells())
+			{
+				RTLIL::Module *sub = design->module(cell->type);
+				if (sub != nullptr) {
+					instances[sub].push_back(std::make_pair(module, cell));
+				}
+				for (auto &conn : cell->connections())
+				{
+					if (!cell->output(conn.first)) {
+						continue;
+					}
+					RTLIL::SigSpec sig = sigmap(conn.second);
+					for (int i = 0; i < sig.size(); i++) {
+						if (sig[i].wire != nullptr) {
+							drivers[module][sig[i]] = Driver{cell, conn.first, i};
+						}
+					}
+				}
+			}
+		}
+
+		std::vector<std::pair<RTLIL::Module*, RTLIL::SigBit>> queue;
+		pool<std::pair<RTLIL::Module*, RTLIL::SigBit>> visited;
+		pool<RTLIL::Cell*> cone;
+
+		// Start with the observation points
+		RTLIL::Module *top_module = design->top_module();
+		for (auto &name : observe)
+		{
+			RTLIL::Module *module = top_module;
+			std::string wire_name = name;
+			size_t pos = name.find('/');
+			if (pos != std::string::npos) {
+				module = design->module(RTLIL::escape_id(name.substr(0, pos)));
+				wire_name = name.substr(pos + 1);
+			}
+			if (module == nullptr)
+				log_cmd_error("Module for observation point `%s' not found!\n", name.c_str());
+			RTLIL::Wire *wire = module->wire(RTLIL::escape_id(wire_name));
+			if (wire == nullptr)
+				log_cmd_error("Observation point `%s' not found in module `%s'!\n", wire_name.c_str(), log_id(module));
+			log_debug("Observation cone: Adding `%s' in module `%s'\n", log_id(wire), log_id(module));
+			for (auto bit : sigmaps.at(module)(RTLIL::SigSpec(wire))) {
+				queue.push_back(std::make_pair(module, bit));
+			}
+		}
+
+		while (!queue.empty())
+		{
+			auto item = queue.back();
+			queue.pop_back();
+			RTLIL::Module *module = item.first;
+			RTLIL::SigBit bit = item.second;
+			if (bit.wire == nullptr || visited.count(item)) {
+				continue;
+			}
+			visited.insert(item);
+
+			// Module input, continue at all instances of the module
+			if (input_bits[module].count(bit)) {
+				for (auto &port_bit : input_bits[module].at(bit))
+				{
+					for (auto &inst : instances[module])
+					{
+						if (!inst.second->hasPort(port_bit.first->name)) {
+							continue;
+						}
+						RTLIL::SigSpec sig = sigmaps.at(inst.first)(inst.second->getPort(port_bit.first->name));
+						if (port_bit.second < sig.size()) {
+							queue.push_back(std::make_pair(inst.first, sig[port_bit.second]));
+						}
+					}
+				}
+			}
+
+			if (!drivers[module].count(bit)) {
+				continue;
+			}
+			Driver &d = drivers[module].at(bit);
+			cone.insert(d.cell);
+			RTLIL::Module *sub = design->module(d.cell->type);
+			if (sub != nullptr) {
+				// Instance output, continue at the output port inside the module
+				RTLIL::Wire *port = sub->wire(d.port);
+				if (port != nullptr && d.offset < port->width) {
+					queue.push_back(std::make_pair(sub, sigmaps.at(sub)(RTLIL::SigBit(port, d.offset))));
+				}
+				continue;
+			}
+			// Cell, continue at all inputs (includes clock and data of flip-flops)
+			for (auto &conn : d.cell->connections())
+			{
+				if (!d.cell->input(conn.first)) {
+					continue;
+				}
+				for (auto b : sigmaps.at(module)(conn.second)) {
+					queue.push_back(std::make_pair(module, b));
+				}
+			}
+		}
+		log_debug("Observation cone: %zu cells in the fan-in\n", cone.size());
+		return cone;
 	}
 
 	typedef std::vector<std::pair<RTLIL::Module*, RTLIL::Wire*>> connectionStorage;
 
-	void add_toplevel_fi_module(RTLIL::Design* design, connectionStorage *addedInputs, connectionStorage *toplevelSigs, bool add_input_signal)
+	struct ModuleStats {
+		dict<RTLIL::IdString, int> cells;
+		int num_cells = 0;
+		int wires = 0;
+		int ports = 0;
+		// Sum of the output widths of all internal cells, a simple estimate of the evaluation cost per cycle
+		int cost = 0;
+	};
+
+	ModuleStats module_stats(RTLIL::Module *module)
+	{
+		ModuleStats stats;
+		for (auto cell : module->cells())
+		{
+			stats.cells[cell->type]++;
+			stats.num_cells++;
+			if (cell->type.isPublic()) {
+				continue;
+			}
+			for (auto &conn : cell->connections()) {
+				if (cell->output(conn.first)) {
+					stats.cost += conn.second.size();
+				}
+			}
+		}
+		for (auto wire : module->wires())
+		{
+			stats.wires++;
+			if (wire->port_input || wire->port_output) {
+				stats.ports++;
+			}
+		}
+		return stats;
+	}
+
+	// Sum the bits of each module and its submodules, `order' lists submodules before their parents
+	dict<RTLIL::IdString, int> forwarded_bits(const std::vector<RTLIL::Module*> &order, dict<RTLIL::IdString, int> &own_bits)
+	{
+		dict<RTLIL::IdString, int> bits;
+		for (auto module : order)
+		{
+			bits[module->name] = own_bits[module->name];
+			for (auto cell : module->cells()) {
+				if (bits.count(cell->type)) {
+					bits[module->name] += bits[cell->type];
+				}
+			}
+		}
+		return bits;
+	}
+
+	// The report file is opened before the design is changed, see `execute'
+	void write_report(RTLIL::Design *design, std::ofstream &f, std::string filename,
+			dict<RTLIL::IdString, ModuleStats> &before, dict<RTLIL::IdString, int> &own_bits,
+			dict<RTLIL::IdString, int> &own_mem_bits)
+	{
+		// Instances of each module in the design hierarchy and the depth below the top-level
+		dict<RTLIL::IdString, int> instances, depth;
+		std::vector<RTLIL::Module*> order;
+		pool<RTLIL::Module*> visited;
+		std::function<void(RTLIL::Module*)> visit = [&](RTLIL::Module *module) {
+			if (!visited.insert(module).second) {
+				return;
+			}
+			for (auto cell : module->cells()) {
+				if (design->module(cell->type) != nullptr) {
+					visit(design->module(cell->type));
+				}
+			}
+			// Submodules before their parents
+			order.push_back(module);
+		};
+		for (auto module : design->modules()) {
+			visit(module);
+		}
+		for (auto it = order.rbegin(); it != order.rend(); ++it)
+		{
+			RTLIL::Module *module = *it;
+			if (module == design->top_module()) {
+				instances[module->name] += 1;
+			}
+			for (auto cell : module->cells()) {
+				if (design->module(cell->type) != nullptr) {
+					instances[cell->type] += instances[module->name];
+					depth[cell->type] = max(depth[cell->type], depth[module->name] + 1);
+				}
+			}
+		}
+		dict<RTLIL::IdString, int> bus_bits = forwarded_bits(order, own_bits);
+		dict<RTLIL::IdString, int> mem_bus_bits = forwarded_bits(order, own_mem_bits);
+
+		ModuleStats empty, total_before, total_after;
+		dict<RTLIL::IdString, int> total_added;
+		int total_wires = 0, total_ports = 0;
+		f << "# addFi instrumentation report\n";
+		f << "# module\tinstances\tdepth\tfi_bits\tfi_bits_forwarded\tfi_mem_bits\tfi_mem_bits_forwarded"
+				"\tadded_cells\tadded_wires\tadded_ports"
+				"\tcells_before\tcells_after\tcost_before\tcost_after\tcost_increase\n";
+		for (auto module : order)
+		{
+			const ModuleStats &b = before.count(module->name) ? before.at(module->name) : empty;
+			ModuleStats a = module_stats(module);
+			int n = instances[module->name];
+			std::string added;
+			for (auto &c : a.cells) {
+				int diff = c.second - (b.cells.count(c.first) ? b.cells.at(c.first) : 0);
+				if (diff > 0) {
+					added += stringf("%s%s:%d", added.empty() ? "" : ",", log_id(c.first), diff);
+					total_added[c.first] += diff * n;
+				}
+			}
+			f << log_id(module) << "\t" << n << "\t" << depth[module->name] << "\t" << own_bits[module->name]
+				<< "\t" << bus_bits[module->name] << "\t" << own_mem_bits[module->name]
+				<< "\t" << mem_bus_bits[module->name] << "\t" << (added.empty() ? "-" : added)
+				<< "\t" << a.wires - b.wires << "\t" << a.ports - b.ports
+				<< "\t" << b.num_cells << "\t" << a.num_cells << "\t" << b.cost << "\t" << a.cost
+				<< "\t" << stringf("%.1f%%", b.cost ? 100.0 * (a.cost - b.cost) / b.cost : 0.0) << "\n";
+			total_before.num_cells += b.num_cells * n;
+			total_before.cost += b.cost * n;
+			total_after.num_cells += a.num_cells * n;
+			total_after.cost += a.cost * n;
+			total_wires += (a.wires - b.wires) * n;
+			total_ports += (a.ports - b.ports) * n;
+		}
+		std::string added;
+		for (auto &c : total_added) {
+			added += stringf("%s%s:%d", added.empty() ? "" : ",", log_id(c.first), c.second);
+		}
+		int total_bits = 0, total_mem_bits = 0;
+		for (auto &o : own_bits) {
+			total_bits += o.second * instances[o.first];
+		}
+		for (auto &o : own_mem_bits) {
+			total_mem_bits += o.second * instances[o.first];
+		}
+		int max_depth = 0;
+		for (auto &d : depth) {
+			max_depth = max(max_depth, d.second);
+		}
+		double increase = total_before.cost ? 100.0 * (total_after.cost - total_before.cost) / total_before.cost : 0.0;
+		f << "total\t-\t" << max_depth << "\t" << total_bits << "\t" << total_bits << "\t" << total_mem_bits
+			<< "\t" << total_mem_bits << "\t" << (added.empty() ? "-" : added)
+			<< "\t" << total_wires << "\t" << total_ports << "\t" << total_before.num_cells << "\t" << total_after.num_cells
+			<< "\t" << total_before.cost << "\t" << total_after.cost << "\t" << stringf("%.1f%%", increase) << "\n";
+		log("Wrote instrumentation report to `%s': %d fault bits, %d memory fault bits, estimated evaluation cost increase %.1f%%\n",
+				filename.c_str(), total_bits, total_mem_bits, increase);
+	}
+
+	// Connect all instances of `sub' in `module' directly to slices of a single new wire, named after the
+	// submodule and its port, so the name does not depend on the order of processing.
+	RTLIL::Wire *forward_local(RTLIL::Module *module, RTLIL::Module *sub, RTLIL::Wire *port, std::string prefix)
+	{
+		int width = 0;
+		for (auto c : module->cells()) {
+			if (c->type == sub->name) {
+				width += port->width;
+			}
+		}
+		if (!width) {
+			return nullptr;
+		}
+		RTLIL::Wire *mod_in = module->addWire(stringf("\\%s_sub_%s_%s", prefix.c_str(), log_id(sub), log_id(port)), width);
+		int offset = 0;
+		for (auto c : module->cells())
+		{
+			if (c->type == sub->name)
+			{
+				log_debug("Connection clean-up: Instance `%s' in `%s', connecting `%s'[%d:%d] to port `%s'\n",
+						log_id(c), log_id(module), log_id(mod_in), offset + port->width - 1, offset, log_id(port));
+				c->setPort(port->name, RTLIL::SigSpec(mod_in, offset, port->width));
+				offset += port->width;
+			}
+		}
+		return mod_in;
+	}
+
+	void add_toplevel_fi_module(RTLIL::Design* design, connectionStorage *addedInputs, connectionStorage *toplevelSigs, bool add_input_signal,
+			bool local = false, std::string prefix = "fi", std::string generator_name = "figenerator")
 	{
 		log_debug("Connection clean-up: Initial number of added inputs to forward: %zu\n", addedInputs->size());
 		connectionStorage work_queue_inputs;
@@ -52,52 +397,52 @@ struct AddFi : public Pass {
 				// Search in all modules, not search for a specific module in the design, but cells of this type.
 				for (auto module : design->modules())
 				{
-					RTLIL::SigSpec fi_cells;
-					// And check for all cells as those can be the instances of modules.
-					for (auto c : module->cells())
-					{
-						// Did we find a cell of the correct type?
-						if (c->type == m.first->name)
-						{
-							// New wire for cell to combine the available signals
-							int cell_width = m.second->width;
-							// TODO The following wire is not really needed later as it is appended to the SigSpec which is then
-							// connected as a wire to the input.
-							// - The unused wires could be deleted later.
-							// - Find another way to connect the cells to the input.
-							//   - Do not create wires here, but just iterate and store the info, then create the SigSpec and connect it
-							//     on the one end to the input and iterate on the other end for connecting the cells.
-							// - Just forward all wires separately (not really nice).
-							Wire *s = module->addWire(stringf("\\fi_%s_%d_%s", log_id(c), i++, log_id(m.second->name)), cell_width);
-							// Collect all signals from all cells to create a single input later
-							fi_cells.append(s);
-							log_debug("Connection clean-up: Instance `%s' in `%s' with width %u, connecting wire `%s' to port `%s'\n",
-									log_id(c), log_id(c->module), cell_width, log_signal(s), log_signal(m.second));
-							c->setPort(m.second->name, s);
-						}
-					}
-					if (fi_cells.size())
-					{
-						// Create a single signal to all cells
-						RTLIL::Wire *mod_in = module->addWire(stringf("\\fi_forward_%s_%d", log_id(module->name), j++), fi_cells.size());
-						if (!module->get_bool_attribute(ID::top))
+					RTLIL::Wire *mod_in = nullptr;
+					if (local) {
+						mod_in = forward_local(module, m.first, m.second, prefix);
+					} else {
+						RTLIL::SigSpec fi_cells;
+						// And check for all cells as those can be the instances of modules.
+						for (auto c : module->cells())
 						{
-							// Forward wires to top
-							mod_in->port_input = true;
-							module->fixup_ports();
+							// Did we find a cell of the correct type?
+							if (c->type == m.first->name)
+							{
+								// New wire for cell to combine the available signals
+								int cell_width = m.second->width;
+								// TODO The following wire is not really needed later as it is appended to the SigSpec which is then
+								// connected as a wire to the input. Use `-local' to connect the cells directly.
+								Wire *s = module->addWire(stringf("\\fi_%s_%d_%s", log_id(c), i++, log_id(m.second->name)), cell_width);
+								// Collect all signals from all cells to create a single input later
+								fi_cells.append(s);
+								log_debug("Connection clean-up: Instance `%s' in `%s' with width %u, connecting wire `%s' to port `%s'\n",
+										log_id(c), log_id(c->module), cell_width, log_signal(s), log_signal(m.second));
+								c->setPort(m.second->name, s);
+							}
 						}
-						module->connect(fi_cells, mod_in);
-						if (!module->get_bool_attribute(ID::top))
+						if (fi_cells.size())
 						{
-							log_debug("Connection clean-up: Adding `%s' to signal forward list\n", log_id(mod_in->name));
-							addedInputs->push_back(std::make_pair(module, mod_in));
-						}
-						else
-						{
-							log_debug("Connection clean-up: Adding signal `%s' to top-level signal list\n", log_signal(mod_in));
-							toplevelSigs->push_back(std::make_pair(module, mod_in));
+							// Create a single signal to all cells
+							mod_in = module->addWire(stringf("\\%s_forward_%s_%d", prefix.c_str(), log_id(module->name), j++), fi_cells.size());
+							module->connect(fi_cells, mod_in);
 						}
 					}
+					if (mod_in == nullptr) {
+						continue;
+					}
+					if (!module->get_bool_attribute(ID::top))
+					{
+						// Forward wires to top
+						mod_in->port_input = true;
+						module->fixup_ports();
+						log_debug("Connection clean-up: Adding `%s' to signal forward list\n", log_id(mod_in->name));
+						addedInputs->push_back(std::make_pair(module, mod_in));
+					}
+					else
+					{
+						log_debug("Connection clean-up: Adding signal `%s' to top-level signal list\n", log_signal(mod_in));
+						toplevelSigs->push_back(std::make_pair(module, mod_in));
+					}
 				}
 			}
 		}
@@ -109,7 +454,7 @@ struct AddFi : public Pass {
 		}
 
 		// Connect all signals at the top to a FI module
-		RTLIL::Module *top_module;
+		RTLIL::Module *top_module = nullptr;
 		for (auto mod : design->modules())
 		{
 			if (mod->get_bool_attribute(ID::top)) {
@@ -124,12 +469,28 @@ struct AddFi : public Pass {
 			return;
 		}
 
+		// Without a generator module the top-level input is directly connected to the forwarded signals
+		if (local) {
+			if (add_input_signal) {
+				RTLIL::SigSpec top_signals;
+				for (auto &t : *toplevelSigs) {
+					top_signals.append(t.second);
+				}
+				auto top_fi_input = top_module->addWire(stringf("\\%s_combined", prefix.c_str()), top_signals.size());
+				top_fi_input->port_input = true;
+				top_module->connect(top_signals, top_fi_input);
+				top_module->fixup_ports();
+				log_debug("Connection clean-up: Added input signal `%s'\n", top_fi_input->name.c_str());
+			}
+			return;
+		}
+
 		// TODO Make it possible to update the figenerator module
 		// This would allow to run the pass more than once for different parts of the design.
 		// This could be useful to run it with different configurations for different parts.
 		// In a successive pass the module should be altered to incorporate the new wires.
 		log_debug("Connection clean-up: Number of signals for top-level module `%s': %lu\n", top_module->name.c_str(), toplevelSigs->size());
-		auto figen = design->addModule("\\figenerator");
+		auto figen = design->addModule(RTLIL::escape_id(generator_name));
 		log_debug("Connection clean-up: Create module `%s'\n", figen->name.c_str());
 		// Connect a single input to all outputs
 		RTLIL::SigSpec passing_signal;
@@ -151,7 +512,7 @@ struct AddFi : public Pass {
 		log_debug("Connection clean-up: Adding combined input port to `%s'\n", figen->name.c_str());
 		RTLIL::Wire *fi_combined_in;
 		if (add_input_signal) {
-			fi_combined_in = figen->addWire("\\fi_combined", total_width);
+			fi_combined_in = figen->addWire(stringf("\\%s_combined", prefix.c_str()), total_width);
 			fi_combined_in->port_input = true;
 			RTLIL::SigSpec input_port(fi_combined_in);
 			figen->connect(passing_signal, input_port);
@@ -169,7 +530,7 @@ struct AddFi : public Pass {
 			u_figen->setPort(l.first->name, l.second);
 		}
 		if (add_input_signal) {
-			auto top_fi_input = top_module->addWire("\\fi_combined", total_width);
+			auto top_fi_input = top_module->addWire(stringf("\\%s_combined", prefix.c_str()), total_width);
 			top_fi_input->port_input = true;
 			u_figen->setPort(fi_combined_in->name, top_fi_input);
 			top_module->fixup_ports();
@@ -262,12 +623,101 @@ struct AddFi : public Pass {
 		appendFiCell(fi_type, module, cell, output, sigOutput, s);
 	}
 
+	// A memory is observable if one of its read ports is in the cone
+	bool mem_in_cone(const Mem &mem, const pool<RTLIL::Cell*> &cone)
+	{
+		if (mem.cell != nullptr) {
+			return cone.count(mem.cell) > 0;
+		}
+		for (auto &rd : mem.rd_ports) {
+			if (rd.cell != nullptr && cone.count(rd.cell)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Add a side-band to a memory which inverts a single bit of a stored word.
+	// The side-band {enable, bit index, address} is appended to `fi_mem_module`.
+	bool insertMemFi(RTLIL::Module *module, Mem &mem, RTLIL::SigSpec *fi_mem_module)
+	{
+		if (mem.wr_ports.empty()) {
+			log_debug("Module `%s': Memory `%s' has no write port, skipping\n", module->name.c_str(), log_id(mem.memid));
+			return false;
+		}
+		// The write back of the read data would be a combinational loop
+		if (!mem.wr_ports.front().clk_enable) {
+			log("Module `%s': Memory `%s' has an asynchronous write port, skipping\n", log_id(module), log_id(mem.memid));
+			return false;
+		}
+		int addr_bits = max(ceil_log2(mem.start_offset + mem.size), 1);
+		int bit_bits = max(ceil_log2(mem.width), 1);
+		RTLIL::Wire *addr = module->addWire(stringf("\\fi_mem_%s_addr", log_id(mem.memid)), addr_bits);
+		RTLIL::Wire *bit = module->addWire(stringf("\\fi_mem_%s_bit", log_id(mem.memid)), bit_bits);
+		RTLIL::Wire *en = module->addWire(stringf("\\fi_mem_%s_en", log_id(mem.memid)), 1);
+		log("Module `%s': Memory `%s' fault control at fi_mem[%d:%d]: address %d bits, bit index %d bits, enable 1 bit\n",
+				log_id(module), log_id(mem.memid), fi_mem_module->size() + addr_bits + bit_bits, fi_mem_module->size(), addr_bits, bit_bits);
+		fi_mem_module->append(addr);
+		fi_mem_module->append(bit);
+		fi_mem_module->append(en);
+
+		// Asynchronous read of the addressed word
+		MemRd rd;
+		rd.removed = false;
+		rd.cell = nullptr;
+		rd.wide_log2 = 0;
+		rd.clk_enable = false;
+		rd.clk_polarity = true;
+		rd.ce_over_srst = false;
+		rd.clk = State::Sx;
+		rd.en = State::S1;
+		rd.arst = State::S0;
+		rd.srst = State::S0;
+		rd.arst_value = Const(State::Sx, mem.width);
+		rd.srst_value = Const(State::Sx, mem.width);
+		rd.init_value = Const(State::Sx, mem.width);
+		rd.addr = addr;
+		rd.data = module->addWire(NEW_ID, mem.width);
+
+		// Write the inverted bit back, clocked like the first write port
+		MemWr &ref = mem.wr_ports.front();
+		MemWr wr;
+		wr.removed = false;
+		wr.cell = nullptr;
+		wr.wide_log2 = 0;
+		wr.clk_enable = ref.clk_enable;
+		wr.clk_polarity = ref.clk_polarity;
+		wr.clk = ref.clk;
+		wr.addr = addr;
+		wr.en = RTLIL::SigSpec(RTLIL::SigBit(en), mem.width);
+		wr.data = module->Xor(NEW_ID, rd.data, module->Shl(NEW_ID, RTLIL::SigSpec(Const(1, mem.width)), bit));
+
+		for (auto &w : mem.wr_ports) {
+			w.priority_mask.push_back(false);
+		}
+		mem.wr_ports.push_back(wr);
+		mem.wr_ports.back().priority_mask = std::vector<bool>(mem.wr_ports.size(), false);
+		for (auto &r : mem.rd_ports) {
+			r.transparency_mask.push_back(false);
+			r.collision_x_mask.push_back(false);
+		}
+		rd.transparency_mask = std::vector<bool>(mem.wr_ports.size(), false);
+		rd.collision_x_mask = std::vector<bool>(mem.wr_ports.size(), false);
+		mem.rd_ports.push_back(rd);
+		mem.emit();
+		return true;
+	}
+
 	void execute(vector<string> args, RTLIL::Design* design) override
 	{
 		bool flag_add_fi_input = true;
 		bool flag_inject_ff = true;
 		bool flag_inject_combinational = true;
+		bool flag_inject_mem = false;
+		bool flag_local = false;
 		std::string option_fi_type;
+		std::string report_file;
+		std::vector<std::string> observe;
 
 		// parse options
 		size_t argidx;
@@ -282,6 +732,14 @@ struct AddFi : public Pass {
 				flag_inject_combinational = false;
 				continue;
 			}
+			if (arg == "-local") {
+				flag_local = true;
+				continue;
+			}
+			if (arg == "-mem") {
+				flag_inject_mem = true;
+				continue;
+			}
 			if (arg == "-no-add-input") {
 				flag_add_fi_input = false;
 				continue;
@@ -292,6 +750,20 @@ struct AddFi : public Pass {
 				option_fi_type = args[argidx];
 				continue;
 			}
+			if (arg == "-report") {
+				if (++argidx >= args.size())
+					log_cmd_error("Option -report requires an additional argument!\n");
+				report_file = args[argidx];
+				continue;
+			}
+			if (arg == "-observe") {
+				if (++argidx >= args.size())
+					log_cmd_error("Option -observe requires an additional argument!\n");
+				for (auto &name : split_tokens(args[argidx], ",")) {
+					observe.push_back(name);
+				}
+				continue;
+			}
 			// TODO do not create the figenerator module
 			// Add a argument to prevent the creation of the module.
 			// Two possible ways to handle the signals:
@@ -304,13 +776,37 @@ struct AddFi : public Pass {
 		}
 		extra_args(args, argidx, design);
 
+		std::ofstream report;
+		if (!report_file.empty()) {
+			report.open(report_file);
+			if (report.fail())
+				log_cmd_error("Can't open report file `%s' for writing: %s\n", report_file.c_str(), strerror(errno));
+		}
+
 		connectionStorage addedInputs, toplevelSigs;
+		connectionStorage addedMemInputs, toplevelMemSigs;
 
 		if (option_fi_type.empty())
 		{
 			option_fi_type = "xor";
 		}
 
+		// Determine the cells visible at the observation points before changing the design
+		pool<RTLIL::Cell*> cone;
+		int num_excluded = 0;
+		int num_excluded_mem = 0;
+		if (!observe.empty()) {
+			cone = observe_cone(design, observe);
+		}
+
+		dict<RTLIL::IdString, ModuleStats> stats_before;
+		dict<RTLIL::IdString, int> fi_bits, fi_mem_bits;
+		if (!report_file.empty()) {
+			for (auto module : design->modules()) {
+				stats_before[module->name] = module_stats(module);
+			}
+		}
+
 		for (auto module : design->selected_modules())
 		{
 			log("Updating module `%s'\n", module->name.c_str());
@@ -322,10 +818,20 @@ struct AddFi : public Pass {
 			{
 				// Only operate on standard cells (do not change modules)
 				if (!cell->type.isPublic()) {
-					if ((flag_inject_ff && cell->type.in(RTLIL::builtin_ff_cell_types()))) {
+					bool is_ff = cell->type.in(RTLIL::builtin_ff_cell_types());
+					if (!observe.empty() && !cone.count(cell)) {
+						// Only count cells which would have been instrumented
+						if (((flag_inject_ff && is_ff) || (flag_inject_combinational && !is_ff)) &&
+								!cell->is_mem_cell() && (cell->hasPort(ID::Q) || cell->hasPort(ID::Y))) {
+							log_debug("Module `%s': Cell `%s' not observable, skipping\n", module->name.c_str(), log_id(cell));
+							num_excluded++;
+						}
+						continue;
+					}
+					if (flag_inject_ff && is_ff) {
 							insertFi(option_fi_type, module, cell, i++, &fi_ff);
 					}
-					if (flag_inject_combinational && !cell->type.in(RTLIL::builtin_ff_cell_types())) {
+					if (flag_inject_combinational && !is_ff) {
 							insertFi(option_fi_type, module, cell, i++, &fi_comb);
 					}
 				}
@@ -334,9 +840,36 @@ struct AddFi : public Pass {
 			log_debug("Module `%s': Updating modules inputs\n", module->name.c_str());
 			addModuleFiInut(module, fi_ff, "\\fi_ff", &addedInputs, &toplevelSigs);
 			addModuleFiInut(module, fi_comb, "\\fi_comb", &addedInputs, &toplevelSigs);
+
+			if (flag_inject_mem) {
+				RTLIL::SigSpec fi_mem;
+				for (auto &mem : Mem::get_selected_memories(module)) {
+					if (!observe.empty() && !mem_in_cone(mem, cone)) {
+						log_debug("Module `%s': Memory `%s' not observable, skipping\n", module->name.c_str(), log_id(mem.memid));
+						num_excluded_mem++;
+						continue;
+					}
+					insertMemFi(module, mem, &fi_mem);
+				}
+				addModuleFiInut(module, fi_mem, "\\fi_mem", &addedMemInputs, &toplevelMemSigs);
+				fi_mem_bits[module->name] += fi_mem.size();
+			}
+			fi_bits[module->name] += fi_ff.size() + fi_comb.size();
+		}
+		if (!observe.empty()) {
+			log("Excluded %d cells outside of the observation cone\n", num_excluded);
+			if (flag_inject_mem) {
+				log("Excluded %d memories outside of the observation cone\n", num_excluded_mem);
+			}
 		}
 		// Update all modified modules in the design and add wiring to the top
-		add_toplevel_fi_module(design, &addedInputs, &toplevelSigs, flag_add_fi_input);
+		add_toplevel_fi_module(design, &addedInputs, &toplevelSigs, flag_add_fi_input, flag_local);
+		if (flag_inject_mem) {
+			add_toplevel_fi_module(design, &addedMemInputs, &toplevelMemSigs, flag_add_fi_input, flag_local, "fi_mem", "fimemgenerator");
+		}
+		if (!report_file.empty()) {
+			write_report(design, report, report_file, stats_before, fi_bits, fi_mem_bits);
+		}
 	}
 } AddFi;
 